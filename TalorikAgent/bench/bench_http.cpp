@@ -0,0 +1,702 @@
+// HTTP load generator for the agent's API.
+//
+// Drives every request/response route registered by
+// SecurityAgent::setupApiRoutes, one route at a time, against an agent
+// started in this process or a server given with --target. Without --rate
+// each connection sends its next request as soon as the previous response is
+// in (closed loop). With --rate requests are sent on a fixed schedule (open
+// loop) and latency is measured from when a request was due rather than when
+// it went out, so a stalled server is charged for the requests it held back
+// (coordinated omission correction). Results go to stdout as a table and,
+// with --json, to a file that can be diffed between releases. Against the
+// in-process agent, heap allocations per request are counted as well.
+
+#include <asio.hpp>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "agents/SecurityAgent.h"
+#include "config/ConfigManager.h"
+#include "utils/Logger.h"
+#include "support/AllocationCounter.h"
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+// Log-linear latency histogram in nanoseconds: exact below 128 ns, then 64
+// buckets per power of two, so percentiles are within 1.6%
+class LatencyHistogram {
+public:
+    void record(uint64_t value) {
+        m_counts[indexOf(value)]++;
+        m_count++;
+        m_sum += value;
+        m_max = std::max(m_max, value);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < kBuckets; ++i) {
+            m_counts[i] += other.m_counts[i];
+        }
+        m_count += other.m_count;
+        m_sum += other.m_sum;
+        m_max = std::max(m_max, other.m_max);
+    }
+
+    uint64_t count() const { return m_count; }
+    uint64_t max() const { return m_max; }
+    double mean() const { return m_count ? static_cast<double>(m_sum) / m_count : 0; }
+
+    // Upper edge of the bucket holding the q-th fraction of samples
+    uint64_t percentile(double q) const {
+        if (m_count == 0) return 0;
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * m_count)));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBuckets; ++i) {
+            seen += m_counts[i];
+            if (seen >= rank) {
+                return std::min(upperBound(i), m_max);
+            }
+        }
+        return m_max;
+    }
+
+private:
+    static constexpr int kSubBits = 6;
+    static constexpr size_t kLinear = 2 << kSubBits;
+    static constexpr size_t kBuckets = kLinear + (63 - kSubBits) * (1 << kSubBits);
+
+    std::vector<uint64_t> m_counts = std::vector<uint64_t>(kBuckets);
+    uint64_t m_count = 0;
+    uint64_t m_max = 0;
+    long double m_sum = 0;
+
+    static size_t indexOf(uint64_t value) {
+        if (value < kLinear) return static_cast<size_t>(value);
+        int msb = kSubBits + 1;
+        while ((value >> msb) > 1) ++msb;
+        uint64_t sub = (value >> (msb - kSubBits)) - (1 << kSubBits);
+        return kLinear + static_cast<size_t>(msb - kSubBits - 1) * (1 << kSubBits) + static_cast<size_t>(sub);
+    }
+
+    static uint64_t upperBound(size_t index) {
+        if (index < kLinear) return index;
+        size_t offset = index - kLinear;
+        int msb = static_cast<int>(offset >> kSubBits) + kSubBits + 1;
+        uint64_t sub = offset & ((1 << kSubBits) - 1);
+        return (((1ull << kSubBits) + sub + 1) << (msb - kSubBits)) - 1;
+    }
+};
+
+struct BenchRoute {
+    std::string method;
+    std::string target;     // path and query
+    std::string body;
+
+    std::string name() const { return method + " " + target; }
+};
+
+// Request/response routes from SecurityAgent::setupApiRoutes. /api/ws and
+// /api/stream push events rather than answer requests, so they are left out.
+std::vector<BenchRoute> agentRoutes() {
+    return {
+        {"GET", "/api/security/metrics", ""},
+        {"GET", "/api/threats/data?range=24h", ""},
+        {"GET", "/api/threats/attack-types", ""},
+        {"GET", "/api/alerts/recent?limit=10", ""},
+        {"GET", "/api/system/status", ""},
+        {"GET", "/api/agent/status", ""},
+        {"GET", "/api/batch", ""},
+        {"POST", "/api/security/scan", "{\"type\":\"quick\"}"},
+    };
+}
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = 0;                   // 0 = start an agent in this process
+    std::string config = "resources/config/agent_config.json";
+    std::vector<std::pair<std::string, std::string>> overrides;    // --set key=value for the in-process agent
+    int connections = 16;
+    int threads = 2;
+    double rate = 0;                // total requests/second, 0 = closed loop
+    double duration = 5;            // seconds measured per route
+    double warmup = 1;              // seconds run before measuring
+    std::vector<std::string> filters;
+    std::vector<BenchRoute> extraRoutes;
+    std::string jsonPath;
+    std::string label;
+    double maxAllocations = -1;     // fail if a route allocates more per request, < 0 = no check
+};
+
+// Counters of one io thread for one route; merged once the run is over
+struct RunStats {
+    LatencyHistogram latency;       // from when the request was due
+    LatencyHistogram service;       // from when it was written
+    std::map<int, uint64_t> statuses;
+    uint64_t errors = 0;
+};
+
+// Allocation counter read at the edges of the measured window
+struct AllocationWindow {
+    uint64_t atStart = 0;
+    uint64_t atEnd = 0;
+};
+
+// Incremental HTTP/1.1 response parser for Content-Length framed responses
+class ResponseParser {
+public:
+    enum class Result { Incomplete, Complete, Invalid };
+
+    Result parse(const std::string& buffer) {
+        size_t headEnd = buffer.find("\r\n\r\n");
+        if (headEnd == std::string::npos) {
+            return buffer.size() > 64 * 1024 ? Result::Invalid : Result::Incomplete;
+        }
+        if (buffer.compare(0, 5, "HTTP/") != 0 || buffer.size() < 12) {
+            return Result::Invalid;
+        }
+        status = std::atoi(buffer.c_str() + 9);
+        keepAlive = true;
+        size_t contentLength = 0;
+
+        size_t lineStart = buffer.find("\r\n") + 2;
+        while (lineStart < headEnd) {
+            size_t lineEnd = buffer.find("\r\n", lineStart);
+            std::string_view line(buffer.data() + lineStart, lineEnd - lineStart);
+            size_t colon = line.find(':');
+            if (colon != std::string_view::npos) {
+                std::string_view name = line.substr(0, colon);
+                std::string_view value = line.substr(colon + 1);
+                while (!value.empty() && value.front() == ' ') value.remove_prefix(1);
+                if (equalsIgnoreCase(name, "Content-Length")) {
+                    contentLength = std::strtoull(std::string(value).c_str(), nullptr, 10);
+                } else if (equalsIgnoreCase(name, "Connection") && equalsIgnoreCase(value, "close")) {
+                    keepAlive = false;
+                } else if (equalsIgnoreCase(name, "Transfer-Encoding")) {
+                    return Result::Invalid;     // the server frames everything with Content-Length
+                }
+            }
+            lineStart = lineEnd + 2;
+        }
+
+        size = headEnd + 4 + contentLength;
+        return buffer.size() >= size ? Result::Complete : Result::Incomplete;
+    }
+
+    int status = 0;
+    bool keepAlive = true;
+    size_t size = 0;        // bytes of the buffer the response takes up
+
+private:
+    static bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+            return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+        });
+    }
+};
+
+// Shared settings of one route run
+struct RunPlan {
+    asio::ip::tcp::endpoint endpoint;
+    std::string request;
+    Clock::time_point measureStart;
+    Clock::time_point measureEnd;
+    Clock::duration interval{0};    // between requests on one connection, open loop only
+};
+
+// One keep-alive client connection. Runs on its io_context's thread only.
+class ClientConnection : public std::enable_shared_from_this<ClientConnection> {
+public:
+    ClientConnection(asio::io_context& ioContext, const RunPlan& plan, RunStats& stats, Clock::time_point firstDue)
+        : socket_(ioContext), timer_(ioContext), plan_(plan), stats_(stats), nextDue_(firstDue) {}
+
+    void start() {
+        connect();
+    }
+
+private:
+    asio::ip::tcp::socket socket_;
+    asio::steady_timer timer_;
+    const RunPlan& plan_;
+    RunStats& stats_;
+    Clock::time_point nextDue_;     // open loop: when the next request is scheduled
+    Clock::time_point due_;
+    Clock::time_point sentAt_;
+    std::string buffer_;
+    ResponseParser parser_;
+
+    void connect() {
+        auto self = shared_from_this();
+        socket_.async_connect(plan_.endpoint, [this, self](asio::error_code ec) {
+            if (ec) {
+                fail();
+                return;
+            }
+            socket_.set_option(asio::ip::tcp::no_delay(true), ec);
+            next();
+        });
+    }
+
+    void next() {
+        Clock::time_point now = Clock::now();
+        if (now >= plan_.measureEnd) {
+            asio::error_code ec;
+            socket_.close(ec);
+            return;
+        }
+
+        if (plan_.interval == Clock::duration::zero()) {
+            due_ = now;
+            send();
+            return;
+        }
+
+        // Open loop: a request that is already late goes out at once but
+        // keeps its scheduled time
+        due_ = nextDue_;
+        nextDue_ += plan_.interval;
+        if (due_ <= now) {
+            send();
+            return;
+        }
+        auto self = shared_from_this();
+        timer_.expires_at(due_);
+        timer_.async_wait([this, self](asio::error_code) { send(); });
+    }
+
+    void send() {
+        sentAt_ = Clock::now();
+        auto self = shared_from_this();
+        asio::async_write(socket_, asio::buffer(plan_.request), [this, self](asio::error_code ec, size_t) {
+            if (ec) {
+                fail();
+                return;
+            }
+            read();
+        });
+    }
+
+    void read() {
+        size_t used = buffer_.size();
+        buffer_.resize(used + 16 * 1024);
+        auto self = shared_from_this();
+        socket_.async_read_some(asio::buffer(&buffer_[used], 16 * 1024), [this, self, used](asio::error_code ec, size_t bytes) {
+            buffer_.resize(used + bytes);
+            if (ec) {
+                fail();
+                return;
+            }
+
+            switch (parser_.parse(buffer_)) {
+            case ResponseParser::Result::Incomplete:
+                read();
+                return;
+            case ResponseParser::Result::Invalid:
+                fail();
+                return;
+            case ResponseParser::Result::Complete:
+                break;
+            }
+
+            Clock::time_point now = Clock::now();
+            if (due_ >= plan_.measureStart && due_ < plan_.measureEnd) {
+                stats_.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - due_).count());
+                stats_.service.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - sentAt_).count());
+                stats_.statuses[parser_.status]++;
+            }
+            buffer_.erase(0, parser_.size);
+
+            if (!parser_.keepAlive) {
+                asio::error_code ignored;
+                socket_.close(ignored);
+                socket_ = asio::ip::tcp::socket(timer_.get_executor());
+                buffer_.clear();
+                connect();
+                return;
+            }
+            next();
+        });
+    }
+
+    // Count the failure and reconnect after a pause, so a refusing server
+    // is not hammered in a tight loop
+    void fail() {
+        if (due_ >= plan_.measureStart && due_ < plan_.measureEnd) {
+            stats_.errors++;
+        }
+        asio::error_code ignored;
+        socket_.close(ignored);
+        socket_ = asio::ip::tcp::socket(timer_.get_executor());
+        buffer_.clear();
+
+        if (Clock::now() >= plan_.measureEnd) return;
+        auto self = shared_from_this();
+        timer_.expires_after(std::chrono::milliseconds(10));
+        timer_.async_wait([this, self](asio::error_code) { connect(); });
+    }
+};
+
+std::string buildRequest(const BenchRoute& route, const Options& options) {
+    std::string request = route.method + " " + route.target + " HTTP/1.1\r\nHost: " + options.host + "\r\n";
+    if (!route.body.empty() || route.method == "POST") {
+        request += "Content-Type: application/json\r\nContent-Length: " + std::to_string(route.body.size()) + "\r\n";
+    }
+    return request + "\r\n" + route.body;
+}
+
+json latencyJson(const LatencyHistogram& histogram) {
+    auto us = [](uint64_t ns) { return std::round(ns / 100.0) / 10.0; };
+    return {
+        {"p50", us(histogram.percentile(0.50))},
+        {"p90", us(histogram.percentile(0.90))},
+        {"p99", us(histogram.percentile(0.99))},
+        {"p999", us(histogram.percentile(0.999))},
+        {"max", us(histogram.max())},
+        {"mean", us(static_cast<uint64_t>(histogram.mean()))},
+    };
+}
+
+json runRoute(const BenchRoute& route, const Options& options, const asio::ip::tcp::endpoint& endpoint, bool inProcess) {
+    RunPlan plan;
+    plan.endpoint = endpoint;
+    plan.request = buildRequest(route, options);
+    Clock::time_point start = Clock::now();
+    plan.measureStart = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.warmup));
+    plan.measureEnd = plan.measureStart + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.duration));
+    if (options.rate > 0) {
+        plan.interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.connections / options.rate));
+    }
+
+    // One io_context per thread with its own stats, like the server's workers
+    std::vector<std::unique_ptr<asio::io_context>> contexts;
+    std::vector<RunStats> stats(options.threads);
+    for (int i = 0; i < options.threads; ++i) {
+        contexts.push_back(std::make_unique<asio::io_context>(1));
+    }
+    for (int i = 0; i < options.connections; ++i) {
+        // Open-loop schedules are staggered so connections don't fire together
+        Clock::time_point firstDue = start + plan.interval * i / options.connections;
+        int thread = i % options.threads;
+        std::make_shared<ClientConnection>(*contexts[thread], plan, stats[thread], firstDue)->start();
+    }
+
+    AllocationWindow allocations;
+    asio::steady_timer windowStart(*contexts[0], plan.measureStart);
+    asio::steady_timer windowEnd(*contexts[0], plan.measureEnd);
+    windowStart.async_wait([&allocations](asio::error_code) { allocations.atStart = AllocationCounter::allocations.load(); });
+    windowEnd.async_wait([&allocations](asio::error_code) { allocations.atEnd = AllocationCounter::allocations.load(); });
+
+    std::vector<std::thread> threads;
+    for (auto& context : contexts) {
+        threads.emplace_back([&context, &plan]() {
+            AllocationCounter::ignoreThread = true;
+            // Requests still unanswered a while after the end are abandoned
+            context->run_until(plan.measureEnd + std::chrono::seconds(2));
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    RunStats total;
+    for (const auto& threadStats : stats) {
+        total.latency.merge(threadStats.latency);
+        total.service.merge(threadStats.service);
+        total.errors += threadStats.errors;
+        for (const auto& status : threadStats.statuses) {
+            total.statuses[status.first] += status.second;
+        }
+    }
+
+    json result = {
+        {"route", route.name()},
+        {"requests", total.latency.count()},
+        {"errors", total.errors},
+        {"rps", std::round(total.latency.count() / options.duration * 10) / 10},
+        {"latencyUs", latencyJson(total.latency)},
+    };
+    json statuses = json::object();
+    for (const auto& status : total.statuses) {
+        statuses[std::to_string(status.first)] = status.second;
+    }
+    result["status"] = statuses;
+    if (options.rate > 0) {
+        // Time from write to response, without the wait for a late slot
+        result["serviceTimeUs"] = latencyJson(total.service);
+    }
+    if (inProcess && total.latency.count() > 0) {
+        // Everything the server allocated while measuring, background work included
+        double perRequest = static_cast<double>(allocations.atEnd - allocations.atStart) / total.latency.count();
+        result["allocationsPerRequest"] = std::round(perRequest * 100) / 100;
+    }
+    return result;
+}
+
+// One blocking GET, for reading the server's backend before a run
+std::optional<std::string> fetch(const asio::ip::tcp::endpoint& endpoint, const std::string& target, const Options& options) {
+    try {
+        asio::io_context ioContext;
+        asio::ip::tcp::socket socket(ioContext);
+        socket.connect(endpoint);
+        asio::write(socket, asio::buffer(buildRequest({"GET", target, ""}, options)));
+
+        std::string buffer;
+        ResponseParser parser;
+        char chunk[16 * 1024];
+        while (true) {
+            buffer.append(chunk, socket.read_some(asio::buffer(chunk)));
+            ResponseParser::Result result = parser.parse(buffer);
+            if (result == ResponseParser::Result::Invalid) return std::nullopt;
+            if (result == ResponseParser::Result::Complete) break;
+        }
+        if (parser.status != 200) return std::nullopt;
+        return buffer.substr(buffer.find("\r\n\r\n") + 4, parser.size - buffer.find("\r\n\r\n") - 4);
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
+}
+
+bool waitForServer(const asio::ip::tcp::endpoint& endpoint) {
+    for (int attempt = 0; attempt < 100; ++attempt) {
+        asio::io_context ioContext;
+        asio::ip::tcp::socket socket(ioContext);
+        asio::error_code ec;
+        socket.connect(endpoint, ec);
+        if (!ec) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    return false;
+}
+
+int freePort() {
+    asio::io_context ioContext;
+    asio::ip::tcp::acceptor acceptor(ioContext, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    return acceptor.local_endpoint().port();
+}
+
+// "true"/"false", integers and numbers keep their type; anything else is a string
+void applyOverride(ConfigManager& config, const std::string& key, const std::string& value) {
+    char* end = nullptr;
+    if (value == "true" || value == "false") {
+        config.setBool(key, value == "true");
+    } else if (std::strtol(value.c_str(), &end, 10), !value.empty() && *end == '\0') {
+        config.setInt(key, std::atoi(value.c_str()));
+    } else if (std::strtod(value.c_str(), &end), !value.empty() && *end == '\0') {
+        config.setDouble(key, std::atof(value.c_str()));
+    } else {
+        config.setString(key, value);
+    }
+}
+
+void printUsage() {
+    std::cout <<
+        "Usage: bench_http [options]\n"
+        "  --target HOST:PORT   benchmark a running server instead of an in-process agent\n"
+        "  --config PATH        agent config for the in-process agent (" "resources/config/agent_config.json)\n"
+        "  --set KEY=VALUE      override an agent config value, e.g. network.io_uring=false\n"
+        "  --connections N      concurrent keep-alive connections (16)\n"
+        "  --threads N          client io threads (2)\n"
+        "  --rate R             open loop at R requests/s in total; default is closed loop\n"
+        "  --duration S         seconds measured per route (5)\n"
+        "  --warmup S           seconds run before measuring each route (1)\n"
+        "  --route TEXT         only routes containing TEXT (repeatable)\n"
+        "  --add METHOD:PATH    benchmark an extra route, e.g. GET:/index.html\n"
+        "  --json PATH          write results as JSON\n"
+        "  --label TEXT         label stored in the JSON, e.g. a release tag\n"
+        "  --max-allocations N  exit with 1 if the in-process server averages more\n"
+        "                       than N heap allocations per request on a route\n";
+}
+
+bool parseArguments(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            printUsage();
+            std::exit(0);
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--target") {
+            size_t colon = value.rfind(':');
+            if (colon == std::string::npos) return false;
+            options.host = value.substr(0, colon);
+            options.port = std::atoi(value.c_str() + colon + 1);
+        } else if (arg == "--config") {
+            options.config = value;
+        } else if (arg == "--set") {
+            size_t equal = value.find('=');
+            if (equal == std::string::npos) return false;
+            options.overrides.emplace_back(value.substr(0, equal), value.substr(equal + 1));
+        } else if (arg == "--connections") {
+            options.connections = std::max(1, std::atoi(value.c_str()));
+        } else if (arg == "--threads") {
+            options.threads = std::max(1, std::atoi(value.c_str()));
+        } else if (arg == "--rate") {
+            options.rate = std::atof(value.c_str());
+        } else if (arg == "--duration") {
+            options.duration = std::max(0.1, std::atof(value.c_str()));
+        } else if (arg == "--warmup") {
+            options.warmup = std::max(0.0, std::atof(value.c_str()));
+        } else if (arg == "--route") {
+            options.filters.push_back(value);
+        } else if (arg == "--add") {
+            size_t colon = value.find(':');
+            if (colon == std::string::npos) return false;
+            options.extraRoutes.push_back({value.substr(0, colon), value.substr(colon + 1), ""});
+        } else if (arg == "--json") {
+            options.jsonPath = value;
+        } else if (arg == "--label") {
+            options.label = value;
+        } else if (arg == "--max-allocations") {
+            options.maxAllocations = std::atof(value.c_str());
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        printUsage();
+        return 2;
+    }
+    options.threads = std::min(options.threads, options.connections);
+    Logger::initialize(Logger::Level::WARNING, "bench_http.log");
+
+    // In-process agent on a free loopback port. Rate limits and the
+    // connection cap would measure the limits, not the server, so they are
+    // off unless --set turns them back on.
+    std::unique_ptr<ConfigManager> config;
+    std::unique_ptr<SecurityAgent> agent;
+    bool inProcess = options.port == 0;
+    if (inProcess) {
+        options.port = freePort();
+        config = std::make_unique<ConfigManager>();
+        config->loadConfig(options.config);
+        config->setInt("network.port", options.port);
+        config->setDouble("network.rate_limit", 0);
+        config->setInt("network.max_connections", 0);
+        config->setString("network.unix_socket", "");
+        config->setBool("security.enable_ssl", false);
+        for (const auto& setting : options.overrides) {
+            applyOverride(*config, setting.first, setting.second);
+        }
+        agent = std::make_unique<SecurityAgent>(config.get());
+        agent->initialize();
+        agent->startApiServer();
+    }
+
+    asio::ip::tcp::endpoint endpoint;
+    try {
+        asio::io_context ioContext;
+        asio::ip::tcp::resolver resolver(ioContext);
+        endpoint = *resolver.resolve(options.host, std::to_string(options.port)).begin();
+    } catch (const std::exception& e) {
+        std::cerr << "Cannot resolve " << options.host << ": " << e.what() << std::endl;
+        return 1;
+    }
+    if (!waitForServer(endpoint)) {
+        std::cerr << "No server listening on " << options.host << ":" << options.port << std::endl;
+        return 1;
+    }
+
+    std::vector<BenchRoute> routes;
+    for (const auto& route : agentRoutes()) {
+        bool wanted = options.filters.empty() || std::any_of(options.filters.begin(), options.filters.end(),
+            [&route](const std::string& filter) { return route.name().find(filter) != std::string::npos; });
+        if (wanted) {
+            routes.push_back(route);
+        }
+    }
+    routes.insert(routes.end(), options.extraRoutes.begin(), options.extraRoutes.end());
+
+    json results = {
+        {"label", options.label},
+        {"target", inProcess ? std::string("in-process") : options.host + ":" + std::to_string(options.port)},
+        {"mode", options.rate > 0 ? "open" : "closed"},
+        {"connections", options.connections},
+        {"threads", options.threads},
+        {"rate", options.rate},
+        {"duration", options.duration},
+        {"warmup", options.warmup},
+    };
+    if (auto status = fetch(endpoint, "/api/agent/status", options)) {
+        json agentStatus = json::parse(*status, nullptr, false);
+        if (agentStatus.is_object() && agentStatus.contains("ioBackend")) {
+            results["ioBackend"] = agentStatus["ioBackend"];
+        }
+    }
+
+    std::printf("%s loop, %d connections on %d threads%s, %.1fs per route after %.1fs warmup\n",
+                options.rate > 0 ? "Open" : "Closed", options.connections, options.threads,
+                options.rate > 0 ? (", " + std::to_string(static_cast<long>(options.rate)) + " req/s").c_str() : "",
+                options.duration, options.warmup);
+    std::printf("%-40s %10s %8s %9s %9s %9s %9s %9s %10s\n", "route", "req/s", "errors", "p50 us", "p99 us", "p999 us",
+                "max us", "non-2xx", "allocs/req");
+
+    results["routes"] = json::array();
+    std::vector<std::string> overAllocating;
+    for (const auto& route : routes) {
+        json result = runRoute(route, options, endpoint, inProcess);
+        uint64_t other = 0;
+        for (const auto& status : result["status"].items()) {
+            if (status.key()[0] != '2') other += status.value().get<uint64_t>();
+        }
+        double allocations = result.value("allocationsPerRequest", -1.0);
+        char allocationsText[24] = "-";
+        if (allocations >= 0) {
+            std::snprintf(allocationsText, sizeof(allocationsText), "%.2f", allocations);
+        }
+        std::printf("%-40s %10.1f %8llu %9.1f %9.1f %9.1f %9.1f %9llu %10s\n", route.name().c_str(),
+                    result["rps"].get<double>(), static_cast<unsigned long long>(result["errors"].get<uint64_t>()),
+                    result["latencyUs"]["p50"].get<double>(), result["latencyUs"]["p99"].get<double>(),
+                    result["latencyUs"]["p999"].get<double>(), result["latencyUs"]["max"].get<double>(),
+                    static_cast<unsigned long long>(other), allocationsText);
+        std::fflush(stdout);
+        if (options.maxAllocations >= 0 && allocations > options.maxAllocations) {
+            overAllocating.push_back(route.name());
+        }
+        results["routes"].push_back(std::move(result));
+    }
+
+    if (!options.jsonPath.empty()) {
+        std::ofstream out(options.jsonPath);
+        out << results.dump(2) << std::endl;
+        if (!out) {
+            std::cerr << "Cannot write " << options.jsonPath << std::endl;
+            return 1;
+        }
+    }
+
+    if (agent) {
+        agent->shutdown();
+    }
+
+    for (const auto& name : overAllocating) {
+        std::cerr << name << " averaged more than " << options.maxAllocations << " allocations per request" << std::endl;
+    }
+    return overAllocating.empty() ? 0 : 1;
+}
@@ -0,0 +1,186 @@
+// Microbenchmark for RateLimiter::tryAcquire.
+//
+// Times one call in the three situations the server puts the limiter in: a
+// small set of busy clients whose buckets stay in the table (hot keys), a
+// stream of clients each seen once, so every call claims or recycles a slot
+// (churning keys), and several threads hammering the same bucket (one key,
+// contended). Reports nanoseconds per call and the share of calls allowed;
+// once a bucket runs dry tryAcquire returns before its compare-and-swap,
+// so compare ns/acquire only between runs with a similar allowed share.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "network/RateLimiter.h"
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+// Highest limit the bucket state can hold, so the hot buckets rarely run dry
+constexpr double kRate = 4'000'000;
+constexpr double kBurst = 4'000'000;
+constexpr uint64_t kHotKeys = 64;
+constexpr uint64_t kBatch = 1024;
+
+struct Result {
+    std::string caseName;
+    unsigned threads = 1;
+    uint64_t calls = 0;
+    double nsPerCall = 0;       // per thread, i.e. the latency of one call
+    double callsPerSecond = 0;  // all threads together
+    double allowedShare = 0;
+};
+
+// Runs threads copies of callOnce(thread, i) for i = 0, 1, ... until
+// duration has passed, each against the same limiter
+template <typename Function>
+Result measure(const char* caseName, unsigned threads, double duration, Function callOnce) {
+    std::atomic<bool> go{false};
+    std::atomic<bool> stop{false};
+    std::vector<uint64_t> calls(threads, 0);
+    std::vector<uint64_t> allowed(threads, 0);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            uint64_t i = 0;
+            uint64_t granted = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (uint64_t end = i + kBatch; i < end; ++i) {
+                    granted += callOnce(t, i) ? 1 : 0;
+                }
+            }
+            calls[t] = i;
+            allowed[t] = granted;
+        });
+    }
+
+    auto start = Clock::now();
+    go.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+    stop.store(true, std::memory_order_relaxed);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    Result result;
+    result.caseName = caseName;
+    result.threads = threads;
+    uint64_t granted = 0;
+    for (unsigned t = 0; t < threads; ++t) {
+        result.calls += calls[t];
+        granted += allowed[t];
+    }
+    result.nsPerCall = elapsed * threads / result.calls;
+    result.callsPerSecond = result.calls / (elapsed / 1e9);
+    result.allowedShare = static_cast<double>(granted) / result.calls;
+    return result;
+}
+
+bool acquire(RateLimiter& limiter, uint64_t key) {
+    double retryAfter = 0;
+    return limiter.tryAcquire(key, kRate, kBurst, retryAfter);
+}
+
+void usage() {
+    std::printf(
+        "Usage: bench_rate_limiter [options]\n"
+        "  --duration S   seconds measured per case (1)\n"
+        "  --threads N    threads in the contended case (hardware threads, at least 2)\n"
+        "  --json PATH    write results as JSON\n"
+        "  --label TEXT   label stored in the JSON, e.g. a release tag\n");
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    double duration = 1.0;
+    unsigned threads = std::max(2u, std::thread::hardware_concurrency());
+    std::string jsonPath;
+    std::string label;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--duration" && hasValue) {
+            duration = std::atof(argv[++i]);
+        } else if (arg == "--threads" && hasValue) {
+            threads = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (arg == "--json" && hasValue) {
+            jsonPath = argv[++i];
+        } else if (arg == "--label" && hasValue) {
+            label = argv[++i];
+        } else {
+            usage();
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+    }
+    if (duration <= 0 || threads == 0) {
+        usage();
+        return 1;
+    }
+
+    std::vector<Result> results;
+    {
+        RateLimiter limiter;
+        results.push_back(measure("hot keys", 1, duration, [&](unsigned, uint64_t i) {
+            return acquire(limiter, i % kHotKeys + 1);
+        }));
+    }
+    {
+        // Far more distinct keys than the table holds, so the probe window
+        // is full and the least recently used bucket is recycled
+        RateLimiter limiter;
+        results.push_back(measure("churning keys", 1, duration, [&](unsigned, uint64_t i) {
+            return acquire(limiter, (i + 1) * 0x9e3779b97f4a7c15ull);
+        }));
+    }
+    {
+        RateLimiter limiter;
+        results.push_back(measure("one key, contended", threads, duration, [&](unsigned, uint64_t) {
+            return acquire(limiter, 42);
+        }));
+    }
+
+    std::printf("%-20s %8s %12s %12s %10s\n", "case", "threads", "ns/acquire", "Macquires/s", "allowed");
+    for (const Result& result : results) {
+        std::printf("%-20s %8u %12.1f %12.2f %9.1f%%\n", result.caseName.c_str(), result.threads,
+                    result.nsPerCall, result.callsPerSecond / 1e6, result.allowedShare * 100);
+    }
+
+    if (!jsonPath.empty()) {
+        json out;
+        out["label"] = label;
+        out["durationSeconds"] = duration;
+        out["results"] = json::array();
+        for (const Result& result : results) {
+            out["results"].push_back({
+                {"case", result.caseName},
+                {"threads", result.threads},
+                {"calls", result.calls},
+                {"nsPerAcquire", result.nsPerCall},
+                {"acquiresPerSecond", result.callsPerSecond},
+                {"allowedShare", result.allowedShare},
+            });
+        }
+        std::ofstream file(jsonPath);
+        if (!file) {
+            std::fprintf(stderr, "Cannot write %s\n", jsonPath.c_str());
+            return 1;
+        }
+        file << out.dump(2) << "\n";
+    }
+    return 0;
+}
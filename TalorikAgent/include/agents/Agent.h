@@ -1,45 +1,29 @@
 #pragma once
 
 #include <string>
-#include <memory>
-#include <functional>
-#include "models/Message.h"
-#include "models/Task.h"
+#include <atomic>
 
+// Base for the agents hosted by the process. initialize() prepares the
+// agent, run() does its work until shutdown() is called from another thread.
 class Agent {
 public:
-    explicit Agent(const std::string& id, const std::string& name);
-    virtual ~Agent() = default;
+    Agent();
+    virtual ~Agent();
 
     // Core agent methods
-    virtual bool initialize() = 0;
-    virtual void process() = 0;
-    virtual void shutdown() = 0;
+    virtual bool initialize();
+    virtual void run();
+    virtual void shutdown();
 
-    // Message handling
-    virtual void receiveMessage(const Message& message);
-    virtual void sendMessage(const std::string& targetId, const Message& message);
+    // Identification
+    virtual std::string getAgentId() const = 0;
+    virtual std::string getAgentType() const = 0;
 
-    // Task management
-    virtual bool assignTask(const Task& task);
-    virtual void completeTask(const std::string& taskId);
-
-    // Getters
-    const std::string& getId() const { return m_id; }
-    const std::string& getName() const { return m_name; }
-    bool isActive() const { return m_active; }
-
-    // Setters
-    void setActive(bool active) { m_active = active; }
+    // State
+    bool isInitialized() const;
+    bool isRunning() const;
 
 protected:
-    std::string m_id;
-    std::string m_name;
-    bool m_active;
     bool m_initialized;
-
-    // Protected helper methods
-    void logInfo(const std::string& message);
-    void logError(const std::string& message);
-    void logDebug(const std::string& message);
-}; 
\ No newline at end of file
+    std::atomic<bool> m_running;
+};
\ No newline at end of file
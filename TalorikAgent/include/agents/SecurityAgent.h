@@ -7,9 +7,12 @@
 #include <thread>
 #include <atomic>
 #include <mutex>
+#include <condition_variable>
+#include <map>
 #include "agents/Agent.h"
 #include "models/SecurityModels.h"
 #include "utils/Logger.h"
+#include "utils/RingBuffer.h"
 #include "network/HttpServer.h"
 
 // Forward declarations
@@ -49,39 +52,56 @@ private:
     std::atomic<bool> m_apiServerRunning;
     std::thread m_apiServerThread;
     std::thread m_dataCollectionThread;
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;         // ends the collection thread's wait on shutdown
     
-    // Simulated data storage
+    // Simulated data storage; history and alerts keep the newest
+    // security.maxThreatHistory / security.maxAlerts entries
     mutable std::mutex m_dataMutex;
-    std::vector<ThreatDataPoint> m_threatHistory;
-    std::vector<Alert> m_alerts;
+    RingBuffer<ThreatDataPoint> m_threatHistory;
+    RingBuffer<Alert> m_alerts;
     std::vector<SystemStatus> m_systemStatus;
     
-    // Statistics
+    // Statistics over m_threatHistory, updated as points are added and
+    // evicted so reads don't depend on the retention size
     std::atomic<int> m_totalThreats;
     std::atomic<int> m_blockedAttacks;
+    std::map<std::string, int> m_attackTypeCounts;  // types with at least one occurrence
+    int m_attackTypeTotal;
     std::atomic<int> m_activeAlerts;
+    std::atomic<uint64_t> m_dataVersion;    // bumped whenever collected data changes
     std::chrono::system_clock::time_point m_startTime;
     std::chrono::system_clock::time_point m_lastScanTime;
     
     // Private helper methods
+    bool createApiServer();
     void runApiServer();
     void runDataCollection();
     void generateSimulatedData();
+    void recordThreat(ThreatDataPoint point);   // caller holds m_dataMutex
     void updateSecurityMetrics();
     std::string getCurrentTimestamp() const;
     std::string formatUptime() const;
     double calculateSecurityScore() const;
     
+    // Bodies of the data getters; callers hold m_dataMutex
+    SecurityMetrics collectSecurityMetrics() const;
+    std::vector<ThreatDataPoint> collectThreatData(const std::string& range) const;
+    std::vector<AttackTypeDistribution> collectAttackTypeDistribution() const;
+    std::vector<Alert> collectRecentAlerts(int limit) const;
+    std::vector<SystemStatus> collectSystemStatus() const;
+    
     // API endpoint handlers
     void setupApiRoutes();
-    std::string handleSecurityMetrics(const std::string& path, const std::map<std::string, std::string>& params);
-    std::string handleThreatData(const std::string& path, const std::map<std::string, std::string>& params);
-    std::string handleAttackTypes(const std::string& path, const std::map<std::string, std::string>& params);
-    std::string handleRecentAlerts(const std::string& path, const std::map<std::string, std::string>& params);
-    std::string handleSystemStatus(const std::string& path, const std::map<std::string, std::string>& params);
-    std::string handleAgentStatus(const std::string& path, const std::map<std::string, std::string>& params);
-    std::string handleSecurityScan(const std::string& path, const std::map<std::string, std::string>& params);
+    std::string handleSecurityMetrics(const HttpServer::HttpRequest& request);
+    std::string handleThreatData(const HttpServer::HttpRequest& request);
+    std::string handleAttackTypes(const HttpServer::HttpRequest& request);
+    std::string handleRecentAlerts(const HttpServer::HttpRequest& request);
+    std::string handleSystemStatus(const HttpServer::HttpRequest& request);
+    std::string handleAgentStatus(const HttpServer::HttpRequest& request);
+    std::string handleSecurityScan(const HttpServer::HttpRequest& request);
+    std::string handleBatch(const HttpServer::HttpRequest& request);
     
-    // HTTP server
+    // HTTP server; created by initialize() before any other thread uses it
     std::unique_ptr<HttpServer> m_httpServer;
 }; 
\ No newline at end of file
@@ -44,6 +44,7 @@ private:
     LogLevel m_logLevel;
 
     // Private helper methods
+    const nlohmann::json* findValue(const std::string& key) const;
     void setDefaultConfig();
     bool parseLogLevel(const std::string& levelStr);
 }; 
\ No newline at end of file
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+enum class ContentEncoding {
+    Identity,
+    Gzip,
+    Deflate
+};
+
+// HTTP content-coding helpers. Compression needs zlib (HAS_ZLIB); without
+// it every negotiation falls back to identity.
+class Compression {
+public:
+    static bool available();
+
+    // Best coding the client accepts, gzip preferred; honours "q=0"
+    static ContentEncoding negotiate(std::string_view acceptEncoding);
+
+    // Header token for a coding ("gzip", "deflate")
+    static const char* name(ContentEncoding encoding);
+
+    // Compress input at level 1-9; false if unavailable or it failed
+    static bool compress(std::string_view input, ContentEncoding encoding, int level, std::string& output);
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Fixed blocks for the asynchronous operations of one owner, such as a
+// connection or a worker. asio allocates every operation, handler included,
+// through the handler's associated allocator; handlers bound here reuse the
+// same few blocks instead of going to the heap each time. Operations that
+// don't fit, or find every block taken, fall back to the heap. Not
+// thread-safe: bind only handlers started from the owner's io thread.
+class HandlerMemory {
+public:
+    HandlerMemory() = default;
+
+    HandlerMemory(const HandlerMemory&) = delete;
+    HandlerMemory& operator=(const HandlerMemory&) = delete;
+
+    void* allocate(size_t size) {
+        if (size <= kSlotSize) {
+            for (auto& slot : m_slots) {
+                if (!slot.used) {
+                    slot.used = true;
+                    return &slot.storage;
+                }
+            }
+        }
+        return ::operator new(size);
+    }
+
+    void deallocate(void* pointer) {
+        for (auto& slot : m_slots) {
+            if (pointer == &slot.storage) {
+                slot.used = false;
+                return;
+            }
+        }
+        ::operator delete(pointer);
+    }
+
+private:
+    // Enough for a read or write plus two timers and their cancelled waits
+    static constexpr size_t kSlotSize = 256;
+    static constexpr size_t kSlots = 6;
+
+    struct Slot {
+        std::aligned_storage_t<kSlotSize, alignof(std::max_align_t)> storage;
+        bool used = false;
+    };
+
+    std::array<Slot, kSlots> m_slots;
+};
+
+template <typename T>
+class HandlerAllocator {
+public:
+    using value_type = T;
+
+    explicit HandlerAllocator(HandlerMemory& memory) : m_memory(&memory) {}
+
+    template <typename U>
+    HandlerAllocator(const HandlerAllocator<U>& other) noexcept : m_memory(other.m_memory) {}
+
+    T* allocate(size_t count) { return static_cast<T*>(m_memory->allocate(sizeof(T) * count)); }
+    void deallocate(T* pointer, size_t) { m_memory->deallocate(pointer); }
+
+    template <typename U>
+    bool operator==(const HandlerAllocator<U>& other) const noexcept { return m_memory == other.m_memory; }
+    template <typename U>
+    bool operator!=(const HandlerAllocator<U>& other) const noexcept { return m_memory != other.m_memory; }
+
+private:
+    template <typename> friend class HandlerAllocator;
+
+    HandlerMemory* m_memory;
+};
+
+// Completion handler that asio allocates from a HandlerMemory
+template <typename Handler>
+class MemoryHandler {
+public:
+    using allocator_type = HandlerAllocator<Handler>;
+
+    MemoryHandler(HandlerMemory& memory, Handler handler) : m_memory(&memory), m_handler(std::move(handler)) {}
+
+    allocator_type get_allocator() const noexcept { return allocator_type(*m_memory); }
+
+    template <typename... Args>
+    void operator()(Args&&... args) { m_handler(std::forward<Args>(args)...); }
+
+private:
+    HandlerMemory* m_memory;
+    Handler m_handler;
+};
+
+template <typename Handler>
+MemoryHandler<std::decay_t<Handler>> bindHandlerMemory(HandlerMemory& memory, Handler&& handler) {
+    return MemoryHandler<std::decay_t<Handler>>(memory, std::forward<Handler>(handler));
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <string_view>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Incremental HTTP/1.x request head parser.
+//
+// The parser never copies: it records offsets into the caller's buffer and
+// hands out std::string_view accessors over it. parse() can be called again
+// with a longer buffer after a partial read and resumes where it stopped, so
+// the buffer may grow (and move) between calls. Views stay valid until the
+// buffer is modified again.
+class HttpParser {
+public:
+    static constexpr size_t kMaxHeaders = 32;
+    static constexpr size_t kMaxHeadSize = 8192;
+    static constexpr size_t kMaxRequestLine = 4096;
+
+    enum class Result {
+        Complete,
+        Incomplete,
+        Error
+    };
+
+    struct Header {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    HttpParser();
+
+    // Parse the request head at the start of data
+    Result parse(std::string_view data);
+
+    // Forget the current request, ready for the next one on the connection
+    void reset();
+
+    // Request line
+    std::string_view method() const { return view(m_method); }
+    std::string_view target() const { return view(m_target); }
+    std::string_view path() const;
+    std::string_view query() const;
+    std::string_view version() const { return view(m_version); }
+
+    // Headers
+    size_t headerCount() const { return m_headerCount; }
+    Header headerAt(size_t index) const;
+    std::string_view header(std::string_view name) const;
+    bool headerHasToken(std::string_view name, std::string_view token) const;
+
+    // Bytes taken by the head including the blank line, valid once Complete
+    size_t headSize() const { return m_headSize; }
+
+    // Status code and reason to answer with after an Error
+    int errorStatus() const { return m_errorStatus; }
+    const char* errorReason() const { return m_errorReason; }
+
+    static bool equalsIgnoreCase(std::string_view a, std::string_view b);
+
+private:
+    struct Span {
+        uint32_t offset = 0;
+        uint32_t length = 0;
+    };
+
+    struct HeaderSpan {
+        Span name;
+        Span value;
+    };
+
+    enum class State {
+        RequestLine,
+        Headers,
+        Done,
+        Failed
+    };
+
+    State m_state;
+    const char* m_data;
+    size_t m_pos;
+
+    Span m_method;
+    Span m_target;
+    Span m_version;
+    std::array<HeaderSpan, kMaxHeaders> m_headers;
+    size_t m_headerCount;
+    size_t m_headSize;
+
+    int m_errorStatus;
+    const char* m_errorReason;
+
+    std::string_view view(Span span) const { return std::string_view(m_data + span.offset, span.length); }
+    bool parseRequestLine(std::string_view line, size_t lineStart);
+    bool parseHeaderLine(std::string_view line, size_t lineStart);
+    Result fail(int status, const char* reason);
+};
+
+// Incremental decoder for a request body framed by Content-Length or by
+// chunked transfer coding. It never buffers body data itself: decode()
+// returns slices of the input it was given.
+class HttpBodyParser {
+public:
+    enum class Result {
+        Complete,
+        Incomplete,
+        Error
+    };
+
+    HttpBodyParser();
+
+    void startContentLength(uint64_t length);
+    void startChunked();
+    void reset();
+
+    // Consume framing from input (advancing it) and set piece to the next
+    // run of body bytes, which may be empty. Call again while Incomplete and
+    // input is not empty.
+    Result decode(std::string_view& input, std::string_view& piece);
+
+    // Body bytes delivered so far
+    uint64_t bodySize() const { return m_bodySize; }
+
+private:
+    enum class State {
+        Length,
+        ChunkSize,
+        ChunkExtension,
+        ChunkSizeLF,
+        ChunkData,
+        ChunkDataCR,
+        ChunkDataLF,
+        TrailerLineStart,
+        TrailerLine,
+        TrailerLF,
+        Done,
+        Failed
+    };
+
+    State m_state;
+    uint64_t m_remaining;
+    uint64_t m_bodySize;
+    bool m_sawDigit;
+};
@@ -2,18 +2,174 @@
 
 #include <asio.hpp>
 #include <string>
+#include <array>
 #include <map>
+#include <vector>
 #include <functional>
 #include <memory>
+#include <memory_resource>
 #include <thread>
 #include <atomic>
+#include <string_view>
+#include <deque>
+#include <mutex>
+#include "network/HttpParser.h"
+#include "network/Router.h"
+#include "network/ResponseCache.h"
+#include "network/Compression.h"
+#include "network/WebSocket.h"
+#include "network/RateLimiter.h"
+#include "network/StaticFiles.h"
 #include "utils/Logger.h"
 
 class HttpServer {
 public:
-    using RequestHandler = std::function<std::string(const std::string&, const std::map<std::string, std::string>&)>;
+    // Request as seen by route handlers. Fields are views into the connection
+    // buffer and are only valid for the duration of the handler call.
+    class HttpRequest {
+    public:
+        HttpRequest(const HttpParser& parser, std::pmr::memory_resource* arena);
+        
+        std::string_view method;
+        std::string_view path;      // without the query string
+        std::string_view query;
+        std::string_view version;
+        RouteParams params;         // path parameters, then query parameters
+        std::string_view body;      // buffered body (empty for streaming routes)
+        asio::ip::address remoteAddress;
+        
+        // Scratch memory released in one go after the response is written.
+        // The server builds response headers here; handlers may use it too,
+        // from the thread they run on.
+        std::pmr::memory_resource* arena;
+        
+        // Case-insensitive header lookup, empty if missing
+        std::string_view header(std::string_view name) const { return m_head.header(name); }
+        bool headerHasToken(std::string_view name, std::string_view token) const {
+            return m_head.headerHasToken(name, token);
+        }
+        
+        // HTTP/1.1 defaults to persistent connections, HTTP/1.0 must opt in
+        bool wantsKeepAlive() const;
+        
+    private:
+        const HttpParser& m_head;
+    };
+    
+    // Handlers return the response body by value; it is moved into the
+    // response and written to the socket without being copied
+    using RequestHandler = std::function<std::string(const HttpRequest& request)>;
+    
+    // Completion handle for an asynchronous handler. Call send() or fail()
+    // exactly once, from any thread; the request stays valid until then.
+    // Calls made after stop() are dropped, but remain safe to make.
+    class Responder {
+    public:
+        void send(std::string body) const { m_complete(std::move(body), false); }
+        void fail(std::string message) const { m_complete(std::move(message), true); }
+        
+    private:
+        friend class HttpServer;
+        explicit Responder(std::function<void(std::string, bool)> complete) : m_complete(std::move(complete)) {}
+        
+        std::function<void(std::string, bool)> m_complete;
+    };
+    
+    // Handler that finishes later, e.g. after waiting on another thread
+    using AsyncHandler = std::function<void(const HttpRequest& request, Responder responder)>;
+    
+    // Receives a request body piece by piece as it arrives, for uploads too
+    // large to buffer. One instance is created per request.
+    class BodyStream {
+    public:
+        virtual ~BodyStream() = default;
+        
+        // Next piece of the decoded body (Content-Length or chunked)
+        virtual void onChunk(std::string_view chunk) = 0;
+        
+        // Called once the body has ended; returns the response body
+        virtual std::string onComplete() = 0;
+    };
+    
+    using StreamHandler = std::function<std::unique_ptr<BodyStream>(const HttpRequest& request)>;
+    
+    // Dispatch order for requests waiting on a worker. High is never shed,
+    // Low is shed first when the server falls behind.
+    enum class Priority {
+        High,
+        Normal,
+        Low
+    };
+    
+    // Per-route behaviour
+    struct RouteOptions {
+        // Version of the data the response is built from. When set, GET
+        // responses are cached per route and normalized params, carry an
+        // ETag, and are re-rendered only after the version changes.
+        std::function<uint64_t()> cacheVersion;
+        
+        // Checked before the cache and the handler. Returning false answers
+        // 400 with the message left in error, so a malformed request is
+        // neither handled nor cached.
+        std::function<bool(const HttpRequest& request, std::string& error)> validate;
+        
+        // Requests per second allowed per client address, with bursts up to
+        // rateBurst (defaults to the rate). 0 falls back to Options::rateLimit.
+        double rateLimit = 0;
+        double rateBurst = 0;
+        
+        Priority priority = Priority::Normal;
+        size_t maxConcurrent = 0;   // handlers running at once across workers, 0 = unlimited
+        
+        // Run the handler on the handler pool rather than the io thread. For
+        // handlers that may block; cache hits are still answered in place.
+        bool offload = false;
+    };
+    
+    // Server options (usually filled from the "network" config section)
+    struct Options {
+        int port = 8080;
+        int workerThreads = 0;      // io_context/thread pairs, 0 = one per core
+        bool reusePort = true;      // per-worker SO_REUSEPORT acceptors where supported
+        int keepAliveTimeout = 5;   // seconds an idle keep-alive connection stays open
+        int requestTimeout = 60;    // seconds to receive a whole request, and to write its response
+        size_t maxConnections = 0;  // open connections before accepting pauses, 0 = unlimited
+        double rateLimit = 0;       // default per-client requests/second for each route, 0 = unlimited
+        double rateBurst = 0;       // default bucket size, 0 = same as the rate
+        int shedTarget = 5;         // ms of queueing delay tolerated before shedding
+        int shedInterval = 100;     // ms window over which the minimum delay is judged
+        int handlerThreads = 2;     // threads running offloaded handlers and static file misses
+        bool coroutines = true;     // one coroutine per connection (builds with HTTP_COROUTINES only)
+        bool ioUring = true;        // io_uring accepts and request I/O (builds with HTTP_IO_URING only)
+        uint64_t maxBodySize = 1024 * 1024;             // buffered request bodies
+        uint64_t maxStreamBodySize = 256 * 1024 * 1024; // streamed request bodies
+        bool compression = true;            // gzip/deflate per Accept-Encoding (needs zlib)
+        size_t compressionMinSize = 1024;   // smaller bodies are sent as they are
+        int compressionLevel = 6;           // zlib level 1 (fast) - 9 (small)
+        size_t webSocketQueueLimit = 64;    // frames queued per push client before it is dropped
+        size_t eventReplayWindow = 256;     // recent events kept for Last-Event-ID resume
+        int eventStreamHeartbeat = 15;      // seconds between keep-alive comments on event streams
+        bool tls = false;                   // serve HTTPS (needs OpenSSL)
+        std::string certificateFile;        // PEM certificate chain
+        std::string privateKeyFile;         // PEM private key
+        long tlsSessionTimeout = 7200;      // seconds a TLS session can be resumed
+        std::string unixSocketPath;         // also serve on this Unix domain socket, empty = off
+        int unixSocketMode = 0660;          // permissions of the socket file
+    };
+    
+    // Connection counters since start()
+    struct Stats {
+        size_t activeConnections = 0;
+        uint64_t acceptedConnections = 0;
+        uint64_t rejectedConnections = 0;   // closed at once because the cap was reached
+        uint64_t timedOutConnections = 0;   // closed by a request or write deadline
+        uint64_t shedRequests = 0;          // answered 503 under overload or over a route's concurrency
+        uint64_t tlsHandshakes = 0;         // full TLS handshakes completed
+        uint64_t tlsResumptions = 0;        // handshakes that resumed an earlier session
+    };
     
     HttpServer(int port = 8080);
+    explicit HttpServer(const Options& options);
     ~HttpServer();
 
     // Start the server
@@ -22,29 +178,181 @@ public:
     // Stop the server
     void stop();
     
-    // Add route handler
+    // Add route handler for a path template such as "/api/alerts/{id}"
+    // (routes must be registered before start())
     void addRoute(const std::string& method, const std::string& path, RequestHandler handler);
+    void addRoute(const std::string& method, const std::string& path, RequestHandler handler,
+                  const RouteOptions& options);
+    
+    // Add route whose handler completes through a Responder
+    void addAsyncRoute(const std::string& method, const std::string& path, AsyncHandler handler,
+                       const RouteOptions& options);
+    
+    // Add route whose request body is streamed to a BodyStream instead of buffered
+    void addStreamingRoute(const std::string& method, const std::string& path, StreamHandler handler);
+    
+    // Serve the files below directory under a path prefix such as "/" or
+    // "/ui". Routes registered with a longer static path take precedence.
+    // Throws std::invalid_argument if the directory does not exist.
+    void addStaticRoute(const std::string& prefix, const std::string& directory,
+                        const StaticFiles::Options& options = StaticFiles::Options());
+    
+    // WebSocket endpoint; every client upgraded on it receives broadcast()
+    void addWebSocketRoute(const std::string& path);
+    
+    // Send a text message to all WebSocket clients. The frame is built once
+    // and shared; clients that fall behind are disconnected.
+    void broadcast(const std::string& message);
+    
+    // Server-Sent Events endpoint (text/event-stream); clients receive
+    // publishEvent() and may resume with Last-Event-ID
+    void addEventStreamRoute(const std::string& path);
+    
+    // Send an event to all event stream clients and keep it for replay
+    void publishEvent(const std::string& type, const std::string& data);
     
     // Set CORS headers
     void enableCors(bool enable = true);
+    
+    // Number of io_context worker threads in use
+    int getWorkerCount() const;
+    
+    // Socket I/O backend in use: "io_uring", or the asio reactor such as "epoll"
+    std::string getIoBackend() const;
+    
+    Stats getStats() const;
+    
+    // Currently connected WebSocket clients
+    size_t getWebSocketClientCount() const;
+    
+    // Currently connected event stream clients
+    size_t getEventStreamClientCount() const;
 
 private:
     class Connection;
-    class HttpRequest;
     class HttpResponse;
+    class Worker;
+    class TlsContext;
+    
+    struct Route {
+        std::string method;
+        std::string path;
+        RequestHandler handler;
+        StreamHandler streamHandler;
+        RouteOptions options;
+        bool webSocket = false;
+        bool eventStream = false;
+        AsyncHandler asyncHandler{};
+        std::shared_ptr<StaticFiles> staticFiles{};
+        std::unique_ptr<std::atomic<size_t>> inFlight = std::make_unique<std::atomic<size_t>>(0);
+    };
+    
+    // Cache state of a request on a cached route, kept from the lookup until
+    // its body has been rendered
+    struct CacheLookup {
+        bool active = false;
+        uint64_t version = 0;
+        std::string key;
+        std::string etag;
+    };
     
-    void acceptConnection();
-    void handleRequest(std::shared_ptr<Connection> connection);
-    std::string parseUrl(const std::string& url, std::map<std::string, std::string>& params);
+    struct Event {
+        uint64_t id;
+        std::shared_ptr<const std::string> frame;   // formatted "id/event/data" block
+    };
     
-    asio::io_context m_ioContext;
-    asio::ip::tcp::acceptor m_acceptor;
-    std::thread m_serverThread;
+    void openAcceptor(Worker& worker);
+    void acceptConnection(Worker& worker);
+    Worker& nextWorker();
+    bool admitConnection();
+    void acceptFailed(asio::steady_timer& timer, bool& failing, const std::error_code& ec, std::function<void()> retry);
+    void acceptSucceeded(bool& failing);
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+    void openLocalAcceptor(Worker& worker);
+    void acceptLocalConnection(Worker& worker);
+#endif
+    void armDeadline(std::shared_ptr<Connection> connection);
+    void cancelDeadline(Connection& connection);
+    void startConnection(std::shared_ptr<Connection> connection);
+    void armIdleTimer(std::shared_ptr<Connection> connection);
+    void readRequest(std::shared_ptr<Connection> connection);
+    bool processRequest(std::shared_ptr<Connection> connection);
+    void readBody(std::shared_ptr<Connection> connection);
+    HttpBodyParser::Result consumeBody(std::shared_ptr<Connection> connection, std::string_view& input);
+    void finishRequest(std::shared_ptr<Connection> connection, std::string_view leftover);
+    void dispatchPending(Worker& worker);
+    bool shouldShed(Worker& worker, Priority priority, std::chrono::steady_clock::duration delay);
+    void runRequest(std::shared_ptr<Connection> connection, bool shed);
+    void failRequest(std::shared_ptr<Connection> connection, int status, const std::string& statusText);
+    void rejectRequest(std::shared_ptr<Connection> connection, HttpResponse&& response);
+    bool allowRequest(uint64_t client, size_t routeId, double& retryAfter);
+    void resetRequest(Connection& connection);
+    void runAsync(std::shared_ptr<Connection> connection, std::atomic<size_t>* inFlight);
+    void completeRequest(std::shared_ptr<Connection> connection, HttpResponse&& response);
+    HttpResponse handleRequest(HttpRequest& request, const Router::Match& match, BodyStream* stream,
+                               CacheLookup& lookup);
+    bool validateRequest(const HttpRequest& request, size_t routeId, HttpResponse& response) const;
+    bool lookupCache(const HttpRequest& request, size_t routeId, CacheLookup& lookup, HttpResponse& response);
+    HttpResponse renderResponse(const HttpRequest& request, const CacheLookup& lookup, std::string body);
+    void serveCacheEntry(const HttpRequest& request, const ResponseCache::Entry& entry, const std::string& etag,
+                         HttpResponse& response) const;
+    bool staticFileResponse(const HttpRequest& request, StaticFiles& files, HttpResponse& response);
+    void findStaticFile(std::shared_ptr<Connection> connection, std::atomic<size_t>* inFlight);
+    HttpResponse assetResponse(const HttpRequest& request, StaticFiles::Asset& asset);
+    ContentEncoding negotiateEncoding(const HttpRequest& request) const;
+    void addCommonHeaders(HttpResponse& response) const;
+    HttpResponse webSocketHandshake(const HttpRequest& request, Connection& connection);
+    void readWebSocket(std::shared_ptr<Connection> connection);
+    HttpResponse eventStreamResponse(const HttpRequest& request, Connection& connection);
+    void startEventStream(std::shared_ptr<Connection> connection);
+    void readEventStream(std::shared_ptr<Connection> connection);
+    void scheduleHeartbeat(Worker& worker);
+    void pushFrame(std::shared_ptr<Connection> connection, std::shared_ptr<const std::string> frame);
+    void flushFrames(std::shared_ptr<Connection> connection);
+    void closeSubscriber(std::shared_ptr<Connection> connection);
+    HttpResponse errorResponse(int status, const std::string& statusText, const std::string& message) const;
+    void writeResponse(std::shared_ptr<Connection> connection, HttpResponse&& response);
+    bool afterResponse(std::shared_ptr<Connection> connection);
+#ifdef HTTP_COROUTINES
+    asio::awaitable<void> serveConnection(std::shared_ptr<Connection> connection);
+#endif
+    
+    // Replaced only by start() and stop(); other threads (broadcast,
+    // publishEvent, getWorkerCount) read it under m_workersMutex
+    std::vector<std::shared_ptr<Worker>> m_workers;
+    mutable std::mutex m_workersMutex;
+    std::atomic<size_t> m_nextWorker;
     std::atomic<bool> m_running;
+    bool m_perWorkerAcceptors;
+    bool m_ioUring;             // workers got a ring in start()
+    
+    std::shared_ptr<std::atomic<size_t>> m_activeConnections;
+    std::atomic<uint64_t> m_acceptedConnections;
+    std::atomic<uint64_t> m_rejectedConnections;
+    std::atomic<uint64_t> m_timedOutConnections;
+    std::atomic<uint64_t> m_shedRequests;
+    std::atomic<uint64_t> m_tlsHandshakes;
+    std::atomic<uint64_t> m_tlsResumptions;
     
-    std::map<std::string, std::map<std::string, RequestHandler>> m_routes;
+    std::vector<Route> m_routes;
+    Router m_router;
+    ResponseCache m_cache;
+    std::unique_ptr<asio::thread_pool> m_handlerPool;
+    std::unique_ptr<TlsContext> m_tls;      // set in start() when serving HTTPS
+    RateLimiter m_rateLimiter;
     bool m_corsEnabled;
+    std::string m_headerBlocks[2];      // common API headers without and with CORS
+    std::string m_keepAliveHeaders;     // Connection and Keep-Alive lines for keep-alive responses
+    std::atomic<size_t> m_webSocketClients;
+    std::atomic<size_t> m_eventStreamClients;
+    bool m_hasEventStreams;
+    
+    // Recent events for Last-Event-ID replay
+    std::mutex m_eventMutex;
+    std::deque<Event> m_eventReplay;
+    uint64_t m_lastEventId;
     
     // Server configuration
+    Options m_options;
     int m_port;
-}; 
\ No newline at end of file
+};
\ No newline at end of file
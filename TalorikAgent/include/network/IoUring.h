@@ -0,0 +1,198 @@
+#pragma once
+
+#ifdef HAS_IO_URING
+
+#include <asio.hpp>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include "network/HandlerMemory.h"
+
+// io_uring driver for one io_context thread.
+//
+// The ring is set up with raw system calls against the kernel headers, so
+// liburing is not needed. The io_context watches the ring fd and runs
+// completions as ordinary handlers on its thread. Operations queued during
+// one turn of the io_context reach the kernel in a single io_uring_enter.
+// Receives take their memory from a registered buffer ring, so idle
+// connections don't pin a read buffer. Not thread-safe: every call must come
+// from the thread running the io_context.
+class IoUring {
+public:
+    // Completion handler for reads and writes. Unlike std::function it keeps
+    // handlers of up to kInlineSize bytes inside the operation, so a request
+    // on a keep-alive connection queues its I/O without allocating.
+    class IoHandler {
+    public:
+        IoHandler() = default;
+
+        template <typename Function, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Function>, IoHandler>>>
+        IoHandler(Function&& function) {
+            emplace<std::decay_t<Function>>(std::forward<Function>(function));
+        }
+
+        IoHandler(IoHandler&& other) noexcept { take(other); }
+
+        IoHandler& operator=(IoHandler&& other) noexcept {
+            if (this != &other) {
+                reset();
+                take(other);
+            }
+            return *this;
+        }
+
+        ~IoHandler() { reset(); }
+
+        explicit operator bool() const { return m_ops != nullptr; }
+        void operator()(std::error_code ec, size_t bytes) { m_ops->invoke(&m_storage, ec, bytes); }
+
+        void reset() {
+            if (m_ops) {
+                m_ops->destroy(&m_storage);
+                m_ops = nullptr;
+            }
+        }
+
+    private:
+        static constexpr size_t kInlineSize = 64;
+
+        struct Ops {
+            void (*invoke)(void* handler, std::error_code ec, size_t bytes);
+            void (*move)(void* from, void* to);
+            void (*destroy)(void* handler);
+        };
+
+        // Handlers too large to keep inline live on the heap
+        template <typename Function>
+        struct Boxed {
+            std::unique_ptr<Function> function;
+            void operator()(std::error_code ec, size_t bytes) { (*function)(ec, bytes); }
+        };
+
+        std::aligned_storage_t<kInlineSize, alignof(std::max_align_t)> m_storage;
+        const Ops* m_ops = nullptr;
+
+        template <typename Stored>
+        static const Ops* opsFor() {
+            static const Ops ops = {
+                [](void* handler, std::error_code ec, size_t bytes) { (*static_cast<Stored*>(handler))(ec, bytes); },
+                [](void* from, void* to) {
+                    new (to) Stored(std::move(*static_cast<Stored*>(from)));
+                    static_cast<Stored*>(from)->~Stored();
+                },
+                [](void* handler) { static_cast<Stored*>(handler)->~Stored(); }
+            };
+            return &ops;
+        }
+
+        template <typename Function, typename Argument>
+        void emplace(Argument&& function) {
+            if constexpr (sizeof(Function) <= kInlineSize && alignof(Function) <= alignof(std::max_align_t) &&
+                          std::is_nothrow_move_constructible_v<Function>) {
+                new (&m_storage) Function(std::forward<Argument>(function));
+                m_ops = opsFor<Function>();
+            } else {
+                new (&m_storage) Boxed<Function>{std::make_unique<Function>(std::forward<Argument>(function))};
+                m_ops = opsFor<Boxed<Function>>();
+            }
+        }
+
+        void take(IoHandler& other) {
+            if (other.m_ops) {
+                other.m_ops->move(&other.m_storage, &m_storage);
+                m_ops = std::exchange(other.m_ops, nullptr);
+            }
+        }
+    };
+
+    // Called once per accepted fd; more is false on the last call, after
+    // which the accept has to be started again
+    using AcceptHandler = std::function<void(std::error_code, int fd, bool more)>;
+
+    // Posts to the io_context are allocated from handlerMemory, which has
+    // to outlive the io_context
+    IoUring(asio::io_context& ioContext, HandlerMemory& handlerMemory);
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // Set up the ring and its receive buffers. Returns false with a reason
+    // if the kernel lacks io_uring or the operations used here (Linux 5.19+).
+    bool open(unsigned entries, unsigned bufferCount, size_t bufferSize, std::string& error);
+
+    // Keep accepting on a listening socket until cancelAccept() or an error
+    void acceptMultishot(int listenFd, AcceptHandler handler);
+    void cancelAccept();
+
+    // Same contracts as socket::async_read_some and asio::async_write
+    void readSome(int fd, asio::mutable_buffer buffer, IoHandler handler);
+    void write(int fd, const asio::const_buffer* buffers, size_t count, IoHandler handler);
+
+    // Hand queued operations to the kernel now. Call before closing an fd
+    // with operations queued, or they could reach a new socket that reuses it.
+    void submit();
+
+private:
+    struct Operation;
+
+    asio::io_context& m_ioContext;
+    HandlerMemory& m_handlerMemory;
+    asio::posix::stream_descriptor m_watch;     // ring fd, readable while completions wait
+    int m_ringFd = -1;
+
+    // Rings shared with the kernel
+    void* m_ring = nullptr;
+    size_t m_ringSize = 0;
+    io_uring_sqe* m_sqes = nullptr;
+    size_t m_sqesSize = 0;
+    unsigned* m_sqHead = nullptr;
+    unsigned* m_sqTailPtr = nullptr;
+    unsigned* m_sqFlags = nullptr;
+    unsigned m_sqMask = 0;
+    unsigned m_sqEntries = 0;
+    unsigned m_sqTail = 0;
+    unsigned* m_cqHead = nullptr;
+    unsigned* m_cqTail = nullptr;
+    unsigned m_cqMask = 0;
+    io_uring_cqe* m_cqes = nullptr;
+
+    unsigned m_queued = 0;          // in the SQ ring, not yet submitted
+    bool m_submitPosted = false;
+    bool m_reaping = false;
+    bool m_closing = false;
+
+    // Registered receive buffers
+    io_uring_buf_ring* m_bufferRing = nullptr;
+    size_t m_bufferRingSize = 0;
+    std::unique_ptr<char[]> m_bufferMemory;
+    unsigned m_bufferCount = 0;
+    size_t m_bufferSize = 0;
+    uint16_t m_bufferTail = 0;
+
+    Operation* m_accept = nullptr;
+    Operation* m_outstanding = nullptr;     // every live operation, freed with the ring
+    Operation* m_free = nullptr;            // finished operations kept for reuse
+    size_t m_freeCount = 0;
+
+    Operation* acquire();
+    io_uring_sqe* nextSqe();
+    void push();
+    void start(Operation* operation);
+    void watch();
+    void reap();
+    void complete(Operation* operation, int result, uint32_t flags);
+    void recycleBuffer(uint16_t id);
+    void link(Operation* operation);
+    void release(Operation* operation);
+    void close();
+};
+
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+// Token buckets keyed by client, for per-client request rate limits.
+//
+// Buckets live in a fixed open-addressing table split into shards. A slot is
+// claimed and updated with compare-and-swap only, so concurrent workers never
+// block each other. The table never grows: when a shard's probe window is
+// full, the slot touched least recently is recycled, so idle clients are the
+// first to be forgotten.
+class RateLimiter {
+public:
+    explicit RateLimiter(size_t capacity = 16384);
+
+    // Take one token from the bucket for key. rate is in tokens per second
+    // and burst is the bucket size. When refused, retryAfter is set to the
+    // seconds until a token will be available.
+    bool tryAcquire(uint64_t key, double rate, double burst, double& retryAfter);
+
+private:
+    static constexpr size_t kShardCount = 64;
+    static constexpr size_t kProbeLimit = 8;
+
+    // state packs the last refill time (ms, high 32 bits) and the tokens
+    // left (thousandths, low 32 bits); 0 means a freshly claimed bucket
+    struct Slot {
+        std::atomic<uint64_t> key{0};
+        std::atomic<uint64_t> state{0};
+    };
+
+    std::unique_ptr<Slot[]> m_slots;
+    size_t m_shardSize;
+    std::chrono::steady_clock::time_point m_epoch;
+
+    Slot& slotFor(uint64_t key, uint32_t now);
+    uint32_t nowMs() const;
+};
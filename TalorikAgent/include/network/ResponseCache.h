@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <unordered_map>
+#include <shared_mutex>
+#include <array>
+#include <cstdint>
+#include "network/Router.h"
+#include "network/Compression.h"
+
+// Cache of serialized response bodies for read-only routes.
+//
+// Entries are keyed by route and normalized parameters and tagged with the
+// data version they were built from; a lookup with a newer version misses,
+// so callers invalidate everything by bumping their version counter. Bodies
+// are shared, so a hit hands out the cached bytes without copying them.
+class ResponseCache {
+public:
+    struct Entry {
+        uint64_t version;
+        std::shared_ptr<const std::string> body;
+        
+        // Compressed variants, filled on first use by encodedBody()
+        mutable std::shared_ptr<const std::string> gzipBody;
+        mutable std::shared_ptr<const std::string> deflateBody;
+    };
+
+    explicit ResponseCache(size_t maxEntries = 1024);
+
+    // Cached entry for key built from exactly this version, or nullptr
+    std::shared_ptr<const Entry> find(const std::string& key, uint64_t version) const;
+
+    // Store a freshly built body and return the entry that now serves it
+    std::shared_ptr<const Entry> store(const std::string& key, uint64_t version, std::string body);
+
+    void clear();
+
+    // Entry body in the given coding, compressed once and then shared. Falls
+    // back to the identity body when compression does not make it smaller.
+    static std::shared_ptr<const std::string> encodedBody(const Entry& entry, ContentEncoding encoding, int level);
+
+    // "routeId?a=1&b=2" with parameters sorted by name. Written over key,
+    // so a string reused across requests keeps its capacity.
+    static void makeKey(size_t routeId, const RouteParams& params, std::string& key);
+
+    // Strong validator derived from version and key, written over etag
+    static void makeETag(uint64_t version, const std::string& key, std::string& etag);
+
+    // True if an If-None-Match header value matches etag
+    static bool matchesETag(std::string_view ifNoneMatch, std::string_view etag);
+
+private:
+    static constexpr size_t kShardCount = 16;
+
+    struct Shard {
+        std::shared_mutex mutex;
+        std::unordered_map<std::string, std::shared_ptr<const Entry>> entries;
+    };
+
+    mutable std::array<Shard, kShardCount> m_shards;
+    size_t m_maxEntriesPerShard;
+
+    Shard& shardFor(const std::string& key) const;
+};
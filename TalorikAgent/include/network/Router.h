@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <memory>
+#include <utility>
+#include <cstddef>
+
+// Parameters captured from a path template ("/api/alerts/{id}") and from
+// the query string. Names and values are views into the route table and the
+// request buffer, held in a fixed array so a lookup never allocates. Query
+// names and values are percent-decoded ('+' is a space); only those that
+// contain escapes are copied, into a buffer owned by the params.
+class RouteParams {
+public:
+    static constexpr size_t kMaxParams = 16;
+
+    RouteParams() : m_count(0) {}
+    RouteParams(const RouteParams& other);
+    RouteParams& operator=(const RouteParams& other);
+
+    // Value of a parameter; path parameters are left percent-encoded
+    std::string_view get(std::string_view name, std::string_view defaultValue = std::string_view()) const;
+    bool has(std::string_view name) const;
+    int getInt(std::string_view name, int defaultValue = 0) const;
+
+    size_t size() const { return m_count; }
+    const std::pair<std::string_view, std::string_view>& operator[](size_t index) const { return m_items[index]; }
+
+    // Parameters past kMaxParams are dropped
+    void add(std::string_view name, std::string_view value);
+    void truncate(size_t count) { if (count < m_count) m_count = count; }
+    void clear() { m_count = 0; m_decoded.clear(); }
+
+    // Split "a=1&b=2" into decoded parameters; path parameters win over
+    // query ones
+    void parseQuery(std::string_view query);
+
+    // Append text to out with %XX escapes and '+' decoded. Malformed escapes
+    // are kept as they are.
+    static void decode(std::string_view text, std::string& out);
+
+private:
+    std::array<std::pair<std::string_view, std::string_view>, kMaxParams> m_items;
+    size_t m_count;
+    std::string m_decoded;      // decoded query text, reserved up front so views into it stay valid
+
+    std::string_view decoded(std::string_view text);
+    void rebase(const char* from, const char* to, size_t size);
+};
+
+// Radix tree over path templates. Static segments are stored as compressed
+// edges, "{name}" segments as a single wildcard child per node. A final
+// "{name*}" segment captures the rest of the path, slashes included, and is
+// tried only after everything else. Lookup cost depends on the path length,
+// not on how many routes are registered.
+class Router {
+public:
+    enum class MatchStatus {
+        Found,
+        NotFound,
+        MethodNotAllowed
+    };
+
+    struct Match {
+        MatchStatus status;
+        size_t routeId;
+    };
+
+    Router();
+    ~Router();
+
+    // Register a route id for method + path template; throws
+    // std::invalid_argument for malformed templates
+    void add(const std::string& method, const std::string& pathTemplate, size_t routeId);
+
+    // Match a request path (without query) and append path parameters
+    Match match(std::string_view method, std::string_view path, RouteParams& params) const;
+
+private:
+    struct Node;
+
+    std::unique_ptr<Node> m_root;
+
+    Node* insertStatic(Node* node, std::string_view text);
+    const Node* matchNode(const Node* node, std::string_view path, RouteParams& params) const;
+    const Node* matchCatchAll(const Node* node, std::string_view path, RouteParams& params) const;
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <asio.hpp>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <shared_mutex>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <filesystem>
+#include "network/Compression.h"
+
+// Files below one directory, e.g. a web UI build.
+//
+// Files up to maxCachedFileSize are read once and kept in memory along with
+// their gzip and deflate forms, so a hit hands out shared bytes. Larger files
+// are opened per request and streamed, with sendfile() where the server can;
+// so is a small file until load() has put it in the cache.
+// Cached files are dropped as soon as they change on disk: through inotify
+// on Linux while watch() is active, otherwise by checking their modification
+// time at most once a second.
+class StaticFiles {
+public:
+    struct Options {
+        size_t maxCachedFileSize = 256 * 1024;      // larger files are streamed from disk
+        size_t maxCacheSize = 32 * 1024 * 1024;     // bytes held, compressed forms included
+        int maxAge = 0;                 // Cache-Control max-age for non-HTML files, 0 = always revalidate
+        std::string indexFile = "index.html";
+        bool indexFallback = true;      // page requests for unknown paths get the index (client-side routing)
+        int compressionLevel = 9;       // zlib level for the cached compressed forms
+    };
+
+    // File opened for streaming one response
+    class OpenFile {
+    public:
+        explicit OpenFile(const std::filesystem::path& path);
+
+        bool isOpen() const { return m_file != nullptr; }
+        std::FILE* get() const { return m_file.get(); }
+        uint64_t size() const { return m_size; }
+
+    private:
+        struct Closer {
+            void operator()(std::FILE* file) const { std::fclose(file); }
+        };
+
+        std::unique_ptr<std::FILE, Closer> m_file;
+        uint64_t m_size;
+    };
+
+    // What to send for a request: cached bytes or an open file
+    struct Asset {
+        std::string contentType;
+        std::string etag;
+        std::string cacheControl;
+        ContentEncoding encoding = ContentEncoding::Identity;  // coding of body
+        std::shared_ptr<const std::string> body;
+        std::shared_ptr<OpenFile> file;
+        std::string loadPath;       // set by a miss on a cacheable file; hand it to load()
+    };
+
+    StaticFiles(const std::string& directory, const Options& options);
+    ~StaticFiles();
+
+    StaticFiles(const StaticFiles&) = delete;
+    StaticFiles& operator=(const StaticFiles&) = delete;
+
+    // Answer from the cache alone, without touching the disk beyond the
+    // once-a-second modification check. False on a miss. Thread-safe.
+    bool findCached(std::string_view path, ContentEncoding accepted, Asset& asset);
+
+    // Resolve a percent-encoded path relative to the directory. False if no
+    // file matches or the path would leave the directory. A browser
+    // navigation (page) to a missing path without an extension gets the
+    // index instead. A file not cached yet is opened for streaming. If it
+    // may be cached, asset.loadPath names it, once until load() runs.
+    // Blocks on the disk; thread-safe.
+    bool find(std::string_view path, ContentEncoding accepted, bool page, Asset& asset);
+
+    // Read a file named by Asset::loadPath into the cache, compressing it
+    // too. Slow for large text files; meant for a background thread.
+    void load(const std::string& relativePath);
+
+    // Invalidate through inotify, handled on ioContext's thread until
+    // unwatch(). Without inotify, modification times are checked instead.
+    void watch(asio::io_context& ioContext);
+    void unwatch();
+
+    const std::string& directory() const { return m_directory; }
+
+private:
+    struct Entry;
+    class Watcher;
+
+    std::string m_directory;
+    std::filesystem::path m_root;
+    Options m_options;
+
+    mutable std::shared_mutex m_mutex;
+    std::unordered_map<std::string, std::shared_ptr<const Entry>> m_entries;   // by relative path
+    size_t m_cacheSize = 0;
+    uint64_t m_generation = 0;      // bumped by every invalidation, so loads racing one are not kept
+    std::unordered_set<std::string> m_loading;  // handed out as loadPath, load() not finished
+
+    std::unique_ptr<Watcher> m_watcher;
+    std::atomic<bool> m_watching;
+
+    std::shared_ptr<const Entry> cached(const std::string& relativePath) const;
+    bool startLoad(const std::string& relativePath);
+    void store(const std::string& relativePath, const std::filesystem::path& path);
+    bool isCurrent(const Entry& entry) const;
+    void invalidate(const std::string& relativePath);
+    void clear();
+    void fill(const Entry& entry, ContentEncoding accepted, Asset& asset) const;
+    std::string cacheControl(std::string_view contentType) const;
+
+    // Decoded path without empty, "." or ".." segments; false for paths
+    // that could escape the directory or name a dotfile
+    static bool normalize(std::string_view path, std::string& relativePath);
+    static const char* contentType(std::string_view relativePath);
+    static bool compressible(std::string_view contentType);
+    static std::string makeETag(uint64_t size, std::filesystem::file_time_type writeTime);
+};
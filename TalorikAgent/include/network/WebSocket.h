@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+// Server side of RFC 6455 framing.
+//
+// Frames built here are unmasked, as the server must send them; frames read
+// from clients must be masked and are unmasked into the caller's Frame.
+class WebSocket {
+public:
+    enum class Opcode : uint8_t {
+        Continuation = 0x0,
+        Text = 0x1,
+        Binary = 0x2,
+        Close = 0x8,
+        Ping = 0x9,
+        Pong = 0xA
+    };
+
+    enum class Result {
+        Complete,
+        Incomplete,
+        Error
+    };
+
+    struct Frame {
+        bool fin = true;
+        Opcode opcode = Opcode::Text;
+        std::string payload;
+    };
+
+    // Close status codes used by the server
+    static constexpr uint16_t kCloseNormal = 1000;
+    static constexpr uint16_t kCloseProtocolError = 1002;
+
+    // Sec-WebSocket-Accept value answering a client's Sec-WebSocket-Key
+    static std::string acceptKey(std::string_view key);
+
+    // Complete unfragmented frame ready to be written to the socket
+    static std::string encodeFrame(Opcode opcode, std::string_view payload);
+    static std::string closeFrame(uint16_t code);
+
+    // Decode the client frame at the start of input and consume its bytes.
+    // Incomplete leaves input untouched; Error means the peer broke the
+    // protocol or sent a payload larger than maxPayload.
+    static Result decodeFrame(std::string_view& input, Frame& frame, uint64_t maxPayload);
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cstddef>
+
+// Fixed-capacity FIFO that keeps the newest elements.
+//
+// Once full, each push overwrites the oldest element in place, so inserting
+// costs the same whatever the capacity. Storage grows on demand up to the
+// capacity, which lets a large retention limit be configured without paying
+// for it until the data arrives. Elements sit in one array, so any run of
+// them is at most two contiguous ranges (see View).
+template <typename T>
+class RingBuffer {
+public:
+    // Elements in insertion order, as the tail of the array followed by its head
+    struct View {
+        const T* first = nullptr;
+        size_t firstSize = 0;
+        const T* second = nullptr;
+        size_t secondSize = 0;
+
+        size_t size() const { return firstSize + secondSize; }
+
+        template <typename Function>
+        void forEach(Function&& function) const {
+            std::for_each(first, first + firstSize, function);
+            std::for_each(second, second + secondSize, function);
+        }
+
+        std::vector<T> toVector() const {
+            std::vector<T> out;
+            out.reserve(size());
+            out.insert(out.end(), first, first + firstSize);
+            out.insert(out.end(), second, second + secondSize);
+            return out;
+        }
+    };
+
+    explicit RingBuffer(size_t capacity)
+        : m_capacity(std::max<size_t>(1, capacity))
+        , m_start(0) {}
+
+    size_t size() const { return m_items.size(); }
+    size_t capacity() const { return m_capacity; }
+    bool empty() const { return m_items.empty(); }
+    bool full() const { return m_items.size() == m_capacity; }
+
+    // Oldest and newest elements; the buffer must not be empty. front() is
+    // the element the next push evicts when full() is true.
+    const T& front() const { return m_items[m_start]; }
+    const T& back() const { return m_items[(m_start + m_items.size() - 1) % m_items.size()]; }
+
+    void push(T item) {
+        if (m_items.size() < m_capacity) {
+            m_items.push_back(std::move(item));
+            return;
+        }
+        m_items[m_start] = std::move(item);
+        m_start = m_start + 1 == m_capacity ? 0 : m_start + 1;
+    }
+
+    // The newest count elements (all of them if there are fewer), oldest first
+    View last(size_t count) const {
+        size_t size = m_items.size();
+        count = std::min(count, size);
+        View view;
+        if (count == 0) {
+            return view;
+        }
+
+        size_t begin = (m_start + size - count) % size;
+        view.first = m_items.data() + begin;
+        view.firstSize = std::min(count, size - begin);
+        view.second = m_items.data();
+        view.secondSize = count - view.firstSize;
+        return view;
+    }
+
+    View all() const { return last(m_items.size()); }
+
+    void clear() {
+        m_items.clear();
+        m_start = 0;
+    }
+
+private:
+    std::vector<T> m_items;
+    size_t m_capacity;
+    size_t m_start;     // index of the oldest element once the buffer has wrapped
+};
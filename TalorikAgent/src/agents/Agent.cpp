@@ -1,5 +1,7 @@
 #include "agents/Agent.h"
 #include "utils/Logger.h"
+#include <thread>
+#include <chrono>
 
 Agent::Agent() : m_initialized(false), m_running(false) {
 }
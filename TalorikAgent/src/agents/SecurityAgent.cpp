@@ -5,18 +5,67 @@
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
+#include <stdexcept>
+#include <array>
+#include <string_view>
 
 using json = nlohmann::json;
 
+namespace {
+    // Resources /api/batch can include, in the order they are read
+    const std::array<std::string_view, 6> kBatchParts = {
+        "metrics", "threats", "attackTypes", "alerts", "systemStatus", "agentStatus"
+    };
+    
+    // Which parts a batch request's comma-separated include list asks for
+    // (all of them by default); false with error set on an unknown name
+    bool batchParts(const HttpServer::HttpRequest& request, std::array<bool, 6>& wanted, std::string& error) {
+        if (!request.params.has("include")) {
+            wanted.fill(true);
+            return true;
+        }
+        
+        wanted.fill(false);
+        std::string_view include = request.params.get("include");
+        while (!include.empty()) {
+            size_t comma = include.find(',');
+            std::string_view name = include.substr(0, comma);
+            include = comma == std::string_view::npos ? std::string_view() : include.substr(comma + 1);
+            if (name.empty()) {
+                continue;
+            }
+            auto it = std::find(kBatchParts.begin(), kBatchParts.end(), name);
+            if (it == kBatchParts.end()) {
+                error = "Unknown resource: " + std::string(name);
+                return false;
+            }
+            wanted[it - kBatchParts.begin()] = true;
+        }
+        return true;
+    }
+}
+
 SecurityAgent::SecurityAgent(ConfigManager* configManager)
     : m_configManager(configManager)
     , m_running(false)
     , m_apiServerRunning(false)
+    , m_threatHistory(std::max(1, configManager->getInt("security.maxThreatHistory", 1000)))
+    , m_alerts(std::max(1, configManager->getInt("security.maxAlerts", 100)))
     , m_totalThreats(0)
     , m_blockedAttacks(0)
+    , m_attackTypeTotal(0)
     , m_activeAlerts(0)
+    , m_dataVersion(0)
     , m_startTime(std::chrono::system_clock::now())
     , m_lastScanTime(std::chrono::system_clock::now()) {
+    // Simulated system status
+    m_systemStatus = {
+        {"Web Server", "online", "99.9%", "server"},
+        {"Database", "online", "99.8%", "database"},
+        {"Firewall", "online", "100%", "shield"},
+        {"Load Balancer", "online", "99.7%", "balance-scale"},
+        {"Monitoring", "online", "99.9%", "eye"}
+    };
 }
 
 SecurityAgent::~SecurityAgent() {
@@ -26,6 +75,12 @@ SecurityAgent::~SecurityAgent() {
 bool SecurityAgent::initialize() {
     Logger::info("Initializing SecurityAgent");
     
+    // The collection thread broadcasts through the server, so it has to
+    // exist before that thread starts
+    if (!createApiServer()) {
+        return false;
+    }
+    
     // Initialize simulated data
     generateSimulatedData();
     
@@ -45,7 +100,11 @@ void SecurityAgent::run() {
 void SecurityAgent::shutdown() {
     Logger::info("SecurityAgent shutting down");
     
-    m_running = false;
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_running = false;
+    }
+    m_wake.notify_all();
     stopApiServer();
     
     if (m_dataCollectionThread.joinable()) {
@@ -69,16 +128,50 @@ void SecurityAgent::stopApiServer() {
     }
 }
 
-void SecurityAgent::runApiServer() {
+bool SecurityAgent::createApiServer() {
     try {
         // Create HTTP server
-        m_httpServer = std::make_unique<HttpServer>(8080);
+        HttpServer::Options options;
+        options.port = m_configManager->getInt("network.port", 8080);
+        options.workerThreads = m_configManager->getInt("network.worker_threads", 0);
+        options.keepAliveTimeout = m_configManager->getInt("network.keep_alive_timeout", 5);
+        options.requestTimeout = m_configManager->getInt("network.timeout", 60);
+        options.maxConnections = m_configManager->getInt("network.max_connections", 100);
+        options.rateLimit = m_configManager->getDouble("network.rate_limit", 0.0);
+        options.rateBurst = m_configManager->getDouble("network.rate_burst", 0.0);
+        options.shedTarget = m_configManager->getInt("network.shed_target_ms", 5);
+        options.shedInterval = m_configManager->getInt("network.shed_interval_ms", 100);
+        options.handlerThreads = m_configManager->getInt("network.handler_threads", 2);
+        options.maxBodySize = m_configManager->getInt("network.max_body_size", 1024 * 1024);
+        options.compression = m_configManager->getBool("network.enable_compression", true);
+        options.compressionLevel = m_configManager->getInt("network.compression_level", 6);
+        options.compressionMinSize = m_configManager->getInt("network.compression_min_size", 1024);
+        options.webSocketQueueLimit = m_configManager->getInt("network.websocket_queue_limit", 64);
+        options.eventReplayWindow = m_configManager->getInt("network.event_replay_window", 256);
+        options.coroutines = m_configManager->getBool("network.coroutines", true);
+        options.ioUring = m_configManager->getBool("network.io_uring", true);
+        options.unixSocketPath = m_configManager->getString("network.unix_socket");
+        options.unixSocketMode = std::stoi(m_configManager->getString("network.unix_socket_mode", "0660"), nullptr, 8);
+        options.tls = m_configManager->getBool("security.enable_ssl", false);
+        options.certificateFile = m_configManager->getString("security.certificate_path");
+        options.privateKeyFile = m_configManager->getString("security.private_key_path");
+        m_httpServer = std::make_unique<HttpServer>(options);
         
         // Setup API routes
         setupApiRoutes();
+        Logger::info("API server configured for port " + std::to_string(options.port) + (options.tls ? " (HTTPS)" : ""));
+        return true;
         
+    } catch (const std::exception& e) {
+        Logger::error("API server setup error: " + std::string(e.what()));
+        return false;
+    }
+}
+
+void SecurityAgent::runApiServer() {
+    try {
         // Start server
-        Logger::info("Starting API server on port 8080");
+        Logger::info("Starting API server");
         m_httpServer->start();
         
     } catch (const std::exception& e) {
@@ -87,47 +180,100 @@ void SecurityAgent::runApiServer() {
 }
 
 void SecurityAgent::setupApiRoutes() {
+    // Read-only data routes are served from cache until the data changes.
+    // Rendering takes m_dataMutex, which collection may hold, so misses run
+    // on the handler pool instead of blocking the io threads.
+    HttpServer::RouteOptions cached;
+    cached.cacheVersion = [this]() { return m_dataVersion.load(); };
+    cached.offload = true;
+    
+    // Health and metrics stay responsive under load; long history queries
+    // and scans are the first to be shed
+    HttpServer::RouteOptions cachedHigh = cached;
+    cachedHigh.priority = HttpServer::Priority::High;
+    HttpServer::RouteOptions cachedLow = cached;
+    cachedLow.priority = HttpServer::Priority::Low;
+    HttpServer::RouteOptions health;
+    health.priority = HttpServer::Priority::High;
+    HttpServer::RouteOptions scan;
+    scan.priority = HttpServer::Priority::Low;
+    scan.maxConcurrent = 1;
+    scan.offload = true;
+    
     // Security Metrics endpoint
     m_httpServer->addRoute("GET", "/api/security/metrics", 
-        [this](const std::string& path, const std::map<std::string, std::string>& params) {
-            return handleSecurityMetrics(path, params);
-        });
+        [this](const HttpServer::HttpRequest& request) {
+            return handleSecurityMetrics(request);
+        }, cachedHigh);
     
     // Threat Data endpoint
     m_httpServer->addRoute("GET", "/api/threats/data", 
-        [this](const std::string& path, const std::map<std::string, std::string>& params) {
-            return handleThreatData(path, params);
-        });
+        [this](const HttpServer::HttpRequest& request) {
+            return handleThreatData(request);
+        }, cachedLow);
     
     // Attack Types endpoint
     m_httpServer->addRoute("GET", "/api/threats/attack-types", 
-        [this](const std::string& path, const std::map<std::string, std::string>& params) {
-            return handleAttackTypes(path, params);
-        });
+        [this](const HttpServer::HttpRequest& request) {
+            return handleAttackTypes(request);
+        }, cached);
     
     // Recent Alerts endpoint
     m_httpServer->addRoute("GET", "/api/alerts/recent", 
-        [this](const std::string& path, const std::map<std::string, std::string>& params) {
-            return handleRecentAlerts(path, params);
-        });
+        [this](const HttpServer::HttpRequest& request) {
+            return handleRecentAlerts(request);
+        }, cached);
     
     // System Status endpoint
     m_httpServer->addRoute("GET", "/api/system/status", 
-        [this](const std::string& path, const std::map<std::string, std::string>& params) {
-            return handleSystemStatus(path, params);
-        });
+        [this](const HttpServer::HttpRequest& request) {
+            return handleSystemStatus(request);
+        }, cached);
     
     // Agent Status endpoint
     m_httpServer->addRoute("GET", "/api/agent/status", 
-        [this](const std::string& path, const std::map<std::string, std::string>& params) {
-            return handleAgentStatus(path, params);
-        });
+        [this](const HttpServer::HttpRequest& request) {
+            return handleAgentStatus(request);
+        }, health);
+    
+    // Several of the above in one response, e.g. for a dashboard's first
+    // load. Not cached: like /api/agent/status, its agentStatus part changes
+    // on every request. Unknown resource names are a 400.
+    HttpServer::RouteOptions batch;
+    batch.offload = true;
+    batch.validate = [](const HttpServer::HttpRequest& request, std::string& error) {
+        std::array<bool, 6> wanted;
+        return batchParts(request, wanted, error);
+    };
+    m_httpServer->addRoute("GET", "/api/batch", 
+        [this](const HttpServer::HttpRequest& request) {
+            return handleBatch(request);
+        }, batch);
     
     // Security Scan endpoint
     m_httpServer->addRoute("POST", "/api/security/scan", 
-        [this](const std::string& path, const std::map<std::string, std::string>& params) {
-            return handleSecurityScan(path, params);
-        });
+        [this](const HttpServer::HttpRequest& request) {
+            return handleSecurityScan(request);
+        }, scan);
+    
+    // Push updates (threat_update, alert_new) to WebSocket clients
+    m_httpServer->addWebSocketRoute("/api/ws");
+    
+    // Same updates as Server-Sent Events for clients that can't use WebSockets
+    m_httpServer->addEventStreamRoute("/api/stream");
+    
+    // The dashboard's production build, so it needs no web server of its own
+    std::string dashboard = m_configManager->getString("dashboard.directory");
+    if (!dashboard.empty()) {
+        StaticFiles::Options files;
+        files.maxAge = m_configManager->getInt("dashboard.max_age", 0);
+        files.maxCacheSize = m_configManager->getInt("dashboard.cache_size", 32 * 1024 * 1024);
+        try {
+            m_httpServer->addStaticRoute("/", dashboard, files);
+        } catch (const std::invalid_argument& e) {
+            Logger::warning(std::string(e.what()) + ", not serving the dashboard");
+        }
+    }
 }
 
 void SecurityAgent::runDataCollection() {
@@ -137,8 +283,9 @@ void SecurityAgent::runDataCollection() {
             generateSimulatedData();
             updateSecurityMetrics();
             
-            // Sleep for 30 seconds
-            std::this_thread::sleep_for(std::chrono::seconds(30));
+            // Wait 30 seconds, or until shutdown
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            m_wake.wait_for(lock, std::chrono::seconds(30), [this]() { return !m_running; });
             
         } catch (const std::exception& e) {
             Logger::error("Data collection error: " + std::string(e.what()));
@@ -168,17 +315,13 @@ void SecurityAgent::generateSimulatedData() {
         point.attack_types.push_back(attackTypes[i]);
     }
     
-    m_threatHistory.push_back(point);
-    
-    // Keep only last 1000 points
-    if (m_threatHistory.size() > 1000) {
-        m_threatHistory.erase(m_threatHistory.begin());
-    }
+    broadcastWebSocketMessage({"threat_update", point.toJson()});
+    recordThreat(std::move(point));
     
     // Generate random alerts
     if (alertDist(gen) == 0) {
         Alert alert;
-        alert.id = m_alerts.size() + 1;
+        alert.id = m_alerts.empty() ? 1 : m_alerts.back().id + 1;
         alert.severity = (std::uniform_int_distribution<>(0, 3)(gen) == 0) ? "critical" : 
                         (std::uniform_int_distribution<>(0, 2)(gen) == 0) ? "high" : "medium";
         alert.description = "Simulated security alert #" + std::to_string(alert.id);
@@ -186,33 +329,51 @@ void SecurityAgent::generateSimulatedData() {
         alert.source_ip = "192.168.1." + std::to_string(std::uniform_int_distribution<>(1, 254)(gen));
         alert.source = alert.source_ip;
         
-        m_alerts.push_back(alert);
-        
-        // Keep only last 100 alerts
-        if (m_alerts.size() > 100) {
-            m_alerts.erase(m_alerts.begin());
+        broadcastWebSocketMessage({"alert_new", alert.toJson()});
+        m_alerts.push(std::move(alert));
+    }
+    
+    m_dataVersion++;
+}
+
+void SecurityAgent::recordThreat(ThreatDataPoint point) {
+    // Take the point about to be evicted out of the running totals
+    if (m_threatHistory.full()) {
+        const ThreatDataPoint& oldest = m_threatHistory.front();
+        m_totalThreats -= oldest.total_threats;
+        m_blockedAttacks -= oldest.blocked_threats;
+        for (const auto& type : oldest.attack_types) {
+            auto it = m_attackTypeCounts.find(type);
+            if (it != m_attackTypeCounts.end() && --it->second == 0) {
+                m_attackTypeCounts.erase(it);
+            }
+            m_attackTypeTotal--;
         }
     }
+    
+    m_totalThreats += point.total_threats;
+    m_blockedAttacks += point.blocked_threats;
+    for (const auto& type : point.attack_types) {
+        m_attackTypeCounts[type]++;
+        m_attackTypeTotal++;
+    }
+    m_threatHistory.push(std::move(point));
 }
 
 void SecurityAgent::updateSecurityMetrics() {
     std::lock_guard<std::mutex> lock(m_dataMutex);
     
-    // Update statistics
-    m_totalThreats = 0;
-    m_blockedAttacks = 0;
-    
-    for (const auto& point : m_threatHistory) {
-        m_totalThreats += point.total_threats;
-        m_blockedAttacks += point.blocked_threats;
-    }
-    
+    // Threat totals are kept current by recordThreat
     m_activeAlerts = m_alerts.size();
+    m_dataVersion++;
 }
 
 SecurityMetrics SecurityAgent::getSecurityMetrics() const {
     std::lock_guard<std::mutex> lock(m_dataMutex);
-    
+    return collectSecurityMetrics();
+}
+
+SecurityMetrics SecurityAgent::collectSecurityMetrics() const {
     SecurityMetrics metrics;
     metrics.totalThreats = m_totalThreats.load();
     metrics.blockedAttacks = m_blockedAttacks.load();
@@ -226,7 +387,10 @@ SecurityMetrics SecurityAgent::getSecurityMetrics() const {
 
 std::vector<ThreatDataPoint> SecurityAgent::getThreatData(const std::string& range) const {
     std::lock_guard<std::mutex> lock(m_dataMutex);
-    
+    return collectThreatData(range);
+}
+
+std::vector<ThreatDataPoint> SecurityAgent::collectThreatData(const std::string& range) const {
     // For demo, return last 24 points (simulating hourly data)
     size_t count = 24;
     if (range == "1h") count = 1;
@@ -234,36 +398,23 @@ std::vector<ThreatDataPoint> SecurityAgent::getThreatData(const std::string& ran
     else if (range == "12h") count = 12;
     else if (range == "7d") count = 168; // 7 * 24
     
-    if (m_threatHistory.size() <= count) {
-        return m_threatHistory;
-    }
-    
-    return std::vector<ThreatDataPoint>(
-        m_threatHistory.end() - count,
-        m_threatHistory.end()
-    );
+    return m_threatHistory.last(count).toVector();
 }
 
 std::vector<AttackTypeDistribution> SecurityAgent::getAttackTypeDistribution() const {
     std::lock_guard<std::mutex> lock(m_dataMutex);
-    
-    std::map<std::string, int> attackCounts;
-    int totalAttacks = 0;
-    
-    // Count attack types from recent data
-    for (const auto& point : m_threatHistory) {
-        for (const auto& type : point.attack_types) {
-            attackCounts[type]++;
-            totalAttacks++;
-        }
-    }
-    
+    return collectAttackTypeDistribution();
+}
+
+std::vector<AttackTypeDistribution> SecurityAgent::collectAttackTypeDistribution() const {
+    // Counts over the retained history are kept by recordThreat
     std::vector<AttackTypeDistribution> distribution;
-    for (const auto& [type, count] : attackCounts) {
+    distribution.reserve(m_attackTypeCounts.size());
+    for (const auto& [type, count] : m_attackTypeCounts) {
         AttackTypeDistribution dist;
         dist.attack_type = type;
         dist.count = count;
-        dist.percentage = totalAttacks > 0 ? (count * 100.0 / totalAttacks) : 0.0;
+        dist.percentage = m_attackTypeTotal > 0 ? (count * 100.0 / m_attackTypeTotal) : 0.0;
         distribution.push_back(dist);
     }
     
@@ -278,31 +429,19 @@ std::vector<AttackTypeDistribution> SecurityAgent::getAttackTypeDistribution() c
 
 std::vector<Alert> SecurityAgent::getRecentAlerts(int limit) const {
     std::lock_guard<std::mutex> lock(m_dataMutex);
-    
-    if (m_alerts.size() <= limit) {
-        return m_alerts;
-    }
-    
-    return std::vector<Alert>(
-        m_alerts.end() - limit,
-        m_alerts.end()
-    );
+    return collectRecentAlerts(limit);
+}
+
+std::vector<Alert> SecurityAgent::collectRecentAlerts(int limit) const {
+    return m_alerts.last(std::max(0, limit)).toVector();
 }
 
 std::vector<SystemStatus> SecurityAgent::getSystemStatus() const {
     std::lock_guard<std::mutex> lock(m_dataMutex);
-    
-    if (m_systemStatus.empty()) {
-        // Initialize system status
-        m_systemStatus = {
-            {"Web Server", "online", "99.9%", "server"},
-            {"Database", "online", "99.8%", "database"},
-            {"Firewall", "online", "100%", "shield"},
-            {"Load Balancer", "online", "99.7%", "balance-scale"},
-            {"Monitoring", "online", "99.9%", "eye"}
-        };
-    }
-    
+    return collectSystemStatus();
+}
+
+std::vector<SystemStatus> SecurityAgent::collectSystemStatus() const {
     return m_systemStatus;
 }
 
@@ -336,8 +475,12 @@ ScanResponse SecurityAgent::triggerSecurityScan(const ScanRequest& request) {
 }
 
 void SecurityAgent::broadcastWebSocketMessage(const WebSocketMessage& message) {
-    // WebSocket broadcasting would be implemented here
-    Logger::info("Broadcasting WebSocket message: " + message.type);
+    // Only queues the frame on the server's workers, so it is safe to call
+    // with m_dataMutex held
+    if (m_httpServer) {
+        m_httpServer->broadcast(message.toJson().dump());
+        m_httpServer->publishEvent(message.type, message.payload.dump());
+    }
 }
 
 std::string SecurityAgent::getCurrentTimestamp() const {
@@ -380,17 +523,13 @@ double SecurityAgent::calculateSecurityScore() const {
 }
 
 // API Handler implementations
-std::string SecurityAgent::handleSecurityMetrics(const std::string& path, const std::map<std::string, std::string>& params) {
+std::string SecurityAgent::handleSecurityMetrics(const HttpServer::HttpRequest& request) {
     auto metrics = getSecurityMetrics();
     return metrics.toJson().dump();
 }
 
-std::string SecurityAgent::handleThreatData(const std::string& path, const std::map<std::string, std::string>& params) {
-    std::string range = "24h";
-    auto it = params.find("range");
-    if (it != params.end()) {
-        range = it->second;
-    }
+std::string SecurityAgent::handleThreatData(const HttpServer::HttpRequest& request) {
+    std::string range(request.params.get("range", "24h"));
     
     auto data = getThreatData(range);
     json response = json::array();
@@ -400,7 +539,7 @@ std::string SecurityAgent::handleThreatData(const std::string& path, const std::
     return response.dump();
 }
 
-std::string SecurityAgent::handleAttackTypes(const std::string& path, const std::map<std::string, std::string>& params) {
+std::string SecurityAgent::handleAttackTypes(const HttpServer::HttpRequest& request) {
     auto data = getAttackTypeDistribution();
     json response = json::array();
     for (const auto& dist : data) {
@@ -409,16 +548,8 @@ std::string SecurityAgent::handleAttackTypes(const std::string& path, const std:
     return response.dump();
 }
 
-std::string SecurityAgent::handleRecentAlerts(const std::string& path, const std::map<std::string, std::string>& params) {
-    int limit = 10;
-    auto it = params.find("limit");
-    if (it != params.end()) {
-        try {
-            limit = std::stoi(it->second);
-        } catch (...) {
-            limit = 10;
-        }
-    }
+std::string SecurityAgent::handleRecentAlerts(const HttpServer::HttpRequest& request) {
+    int limit = request.params.getInt("limit", 10);
     
     auto alerts = getRecentAlerts(limit);
     json response = json::array();
@@ -428,7 +559,7 @@ std::string SecurityAgent::handleRecentAlerts(const std::string& path, const std
     return response.dump();
 }
 
-std::string SecurityAgent::handleSystemStatus(const std::string& path, const std::map<std::string, std::string>& params) {
+std::string SecurityAgent::handleSystemStatus(const HttpServer::HttpRequest& request) {
     auto status = getSystemStatus();
     json response = json::array();
     for (const auto& sys : status) {
@@ -437,17 +568,68 @@ std::string SecurityAgent::handleSystemStatus(const std::string& path, const std
     return response.dump();
 }
 
-std::string SecurityAgent::handleAgentStatus(const std::string& path, const std::map<std::string, std::string>& params) {
-    auto status = getAgentStatus();
-    return status.toJson().dump();
+std::string SecurityAgent::handleAgentStatus(const HttpServer::HttpRequest& request) {
+    auto status = getAgentStatus().toJson();
+    status["ioBackend"] = m_httpServer->getIoBackend();
+    return status.dump();
+}
+
+std::string SecurityAgent::handleBatch(const HttpServer::HttpRequest& request) {
+    // The route's validator has already rejected unknown names
+    std::array<bool, 6> wanted;
+    std::string error;
+    if (!batchParts(request, wanted, error)) {
+        throw std::invalid_argument(error);
+    }
+    
+    std::string range(request.params.get("range", "24h"));
+    int limit = request.params.getInt("limit", 10);
+    
+    // Copy everything under one lock so the parts describe the same moment;
+    // JSON is built after it is released
+    SecurityMetrics metrics;
+    std::vector<ThreatDataPoint> threats;
+    std::vector<AttackTypeDistribution> attackTypes;
+    std::vector<Alert> alerts;
+    std::vector<SystemStatus> systemStatus;
+    {
+        std::lock_guard<std::mutex> lock(m_dataMutex);
+        if (wanted[0]) metrics = collectSecurityMetrics();
+        if (wanted[1]) threats = collectThreatData(range);
+        if (wanted[2]) attackTypes = collectAttackTypeDistribution();
+        if (wanted[3]) alerts = collectRecentAlerts(limit);
+        if (wanted[4]) systemStatus = collectSystemStatus();
+    }
+    
+    auto toArray = [](const auto& items) {
+        json array = json::array();
+        for (const auto& item : items) {
+            array.push_back(item.toJson());
+        }
+        return array;
+    };
+    
+    json response = json::object();
+    if (wanted[0]) response["metrics"] = metrics.toJson();
+    if (wanted[1]) response["threats"] = toArray(threats);
+    if (wanted[2]) response["attackTypes"] = toArray(attackTypes);
+    if (wanted[3]) response["alerts"] = toArray(alerts);
+    if (wanted[4]) response["systemStatus"] = toArray(systemStatus);
+    if (wanted[5]) {
+        response["agentStatus"] = getAgentStatus().toJson();
+        response["agentStatus"]["ioBackend"] = m_httpServer->getIoBackend();
+    }
+    return response.dump();
 }
 
-std::string SecurityAgent::handleSecurityScan(const std::string& path, const std::map<std::string, std::string>& params) {
+std::string SecurityAgent::handleSecurityScan(const HttpServer::HttpRequest& request) {
     try {
-        // For POST requests, we would need to parse the body
-        // For now, we'll use a default scan type
+        // Empty body means a default full scan
         ScanRequest scanRequest;
         scanRequest.type = "full";
+        if (!request.body.empty()) {
+            scanRequest = ScanRequest::fromJson(json::parse(request.body.begin(), request.body.end()));
+        }
         
         auto response = triggerSecurityScan(scanRequest);
         return response.toJson().dump();
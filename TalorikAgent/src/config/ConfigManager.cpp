@@ -61,7 +61,8 @@ bool ConfigManager::loadConfigFromString(const std::string& configJson) {
 
 std::string ConfigManager::getString(const std::string& key, const std::string& defaultValue) const {
     try {
-        return m_config.value(key, defaultValue);
+        const nlohmann::json* value = findValue(key);
+        return value ? value->get<std::string>() : defaultValue;
     } catch (...) {
         return defaultValue;
     }
@@ -69,7 +70,8 @@ std::string ConfigManager::getString(const std::string& key, const std::string&
 
 int ConfigManager::getInt(const std::string& key, int defaultValue) const {
     try {
-        return m_config.value(key, defaultValue);
+        const nlohmann::json* value = findValue(key);
+        return value ? value->get<int>() : defaultValue;
     } catch (...) {
         return defaultValue;
     }
@@ -77,7 +79,8 @@ int ConfigManager::getInt(const std::string& key, int defaultValue) const {
 
 double ConfigManager::getDouble(const std::string& key, double defaultValue) const {
     try {
-        return m_config.value(key, defaultValue);
+        const nlohmann::json* value = findValue(key);
+        return value ? value->get<double>() : defaultValue;
     } catch (...) {
         return defaultValue;
     }
@@ -85,12 +88,44 @@ double ConfigManager::getDouble(const std::string& key, double defaultValue) con
 
 bool ConfigManager::getBool(const std::string& key, bool defaultValue) const {
     try {
-        return m_config.value(key, defaultValue);
+        const nlohmann::json* value = findValue(key);
+        return value ? value->get<bool>() : defaultValue;
     } catch (...) {
         return defaultValue;
     }
 }
 
+const nlohmann::json* ConfigManager::findValue(const std::string& key) const {
+    // Exact key first, then walk dotted paths such as "network.port"
+    auto it = m_config.find(key);
+    if (it != m_config.end()) {
+        return &*it;
+    }
+    
+    const nlohmann::json* node = &m_config;
+    size_t start = 0;
+    while (start <= key.size()) {
+        size_t dot = key.find('.', start);
+        std::string part = key.substr(start, dot == std::string::npos ? std::string::npos : dot - start);
+        
+        if (!node->is_object()) {
+            return nullptr;
+        }
+        auto child = node->find(part);
+        if (child == node->end()) {
+            return nullptr;
+        }
+        node = &*child;
+        
+        if (dot == std::string::npos) {
+            return node;
+        }
+        start = dot + 1;
+    }
+    
+    return nullptr;
+}
+
 LogLevel ConfigManager::getLogLevel() const {
     return m_logLevel;
 }
@@ -131,6 +166,10 @@ void ConfigManager::setDefaultConfig() {
             {"port", 8080},
             {"host", "0.0.0.0"}
         }},
+        {"network", {
+            {"port", 8080},
+            {"worker_threads", 0}
+        }},
         {"security", {
             {"dataCollectionInterval", 30},
             {"maxThreatHistory", 1000},
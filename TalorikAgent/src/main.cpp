@@ -17,7 +17,8 @@ int main(int argc, char* argv[])
         }
 
         // Initialize logging
-        Logger::initialize(configManager->getLogLevel());
+        // LogLevel lists the same levels as Logger::Level, in the same order
+        Logger::initialize(static_cast<Logger::Level>(configManager->getLogLevel()));
 
         // Create and start security agent
         auto securityAgent = std::make_unique<SecurityAgent>(configManager.get());
@@ -0,0 +1,124 @@
+#include "network/Compression.h"
+#include "network/HttpParser.h"
+#include <algorithm>
+
+#ifdef HAS_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+
+// "q=0.5" style weight; anything unparsable counts as 1
+double parseQuality(std::string_view value) {
+    if (value.empty() || (value[0] != '0' && value[0] != '1')) {
+        return 1.0;
+    }
+    double quality = value[0] - '0';
+    double scale = 0.1;
+    for (size_t i = 2; i < value.size() && i < 5 && value[1] == '.'; ++i) {
+        if (value[i] < '0' || value[i] > '9') break;
+        quality += (value[i] - '0') * scale;
+        scale /= 10;
+    }
+    return std::min(quality, 1.0);
+}
+
+// q-value of a coding in an Accept-Encoding list, -1 if not listed
+double qualityOf(std::string_view acceptEncoding, std::string_view coding) {
+    double wildcard = -1.0;
+    while (!acceptEncoding.empty()) {
+        size_t comma = acceptEncoding.find(',');
+        std::string_view item = acceptEncoding.substr(0, comma);
+
+        size_t semicolon = item.find(';');
+        std::string_view token = item.substr(0, semicolon);
+        while (!token.empty() && token.front() == ' ') token.remove_prefix(1);
+        while (!token.empty() && token.back() == ' ') token.remove_suffix(1);
+
+        double quality = 1.0;
+        if (semicolon != std::string_view::npos) {
+            std::string_view params = item.substr(semicolon + 1);
+            size_t q = params.find("q=");
+            if (q != std::string_view::npos) {
+                quality = parseQuality(params.substr(q + 2));
+            }
+        }
+
+        if (HttpParser::equalsIgnoreCase(token, coding)) {
+            return quality;
+        }
+        if (token == "*") {
+            wildcard = quality;
+        }
+
+        if (comma == std::string_view::npos) break;
+        acceptEncoding.remove_prefix(comma + 1);
+    }
+    return wildcard;
+}
+
+}
+
+bool Compression::available() {
+#ifdef HAS_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+ContentEncoding Compression::negotiate(std::string_view acceptEncoding) {
+    if (!available() || acceptEncoding.empty()) {
+        return ContentEncoding::Identity;
+    }
+
+    double gzip = qualityOf(acceptEncoding, "gzip");
+    double deflate = qualityOf(acceptEncoding, "deflate");
+    if (gzip > 0.0 && gzip >= deflate) {
+        return ContentEncoding::Gzip;
+    }
+    if (deflate > 0.0) {
+        return ContentEncoding::Deflate;
+    }
+    return ContentEncoding::Identity;
+}
+
+const char* Compression::name(ContentEncoding encoding) {
+    switch (encoding) {
+        case ContentEncoding::Gzip: return "gzip";
+        case ContentEncoding::Deflate: return "deflate";
+        default: return "identity";
+    }
+}
+
+bool Compression::compress(std::string_view input, ContentEncoding encoding, int level, std::string& output) {
+#ifdef HAS_ZLIB
+    if (encoding == ContentEncoding::Identity) {
+        return false;
+    }
+
+    // gzip wrapper for "gzip", zlib wrapper for HTTP "deflate" (RFC 1950)
+    int windowBits = encoding == ContentEncoding::Gzip ? 15 + 16 : 15;
+    z_stream stream{};
+    if (deflateInit2(&stream, std::clamp(level, 1, 9), Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+
+    output.resize(deflateBound(&stream, static_cast<uLong>(input.size())));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    stream.avail_in = static_cast<uInt>(input.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&output[0]);
+    stream.avail_out = static_cast<uInt>(output.size());
+
+    int result = deflate(&stream, Z_FINISH);
+    output.resize(stream.total_out);
+    deflateEnd(&stream);
+    return result == Z_STREAM_END;
+#else
+    (void)input;
+    (void)encoding;
+    (void)level;
+    (void)output;
+    return false;
+#endif
+}
@@ -0,0 +1,321 @@
+#include "network/HttpParser.h"
+#include <algorithm>
+#include <cctype>
+
+namespace {
+
+bool isTokenChar(char c) {
+    // RFC 7230 tchar
+    if (std::isalnum(static_cast<unsigned char>(c))) return true;
+    switch (c) {
+        case '!': case '#': case '$': case '%': case '&': case '\'': case '*':
+        case '+': case '-': case '.': case '^': case '_': case '`': case '|': case '~':
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool isToken(std::string_view value) {
+    if (value.empty()) return false;
+    for (char c : value) {
+        if (!isTokenChar(c)) return false;
+    }
+    return true;
+}
+
+std::string_view trim(std::string_view value) {
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+    return value;
+}
+
+}
+
+HttpParser::HttpParser() {
+    reset();
+}
+
+void HttpParser::reset() {
+    m_state = State::RequestLine;
+    m_data = nullptr;
+    m_pos = 0;
+    m_method = Span();
+    m_target = Span();
+    m_version = Span();
+    m_headerCount = 0;
+    m_headSize = 0;
+    m_errorStatus = 0;
+    m_errorReason = "";
+}
+
+HttpParser::Result HttpParser::parse(std::string_view data) {
+    m_data = data.data();
+
+    if (m_state == State::Done) return Result::Complete;
+    if (m_state == State::Failed) return Result::Error;
+
+    while (true) {
+        size_t eol = data.find('\n', m_pos);
+        if (eol == std::string_view::npos) {
+            // Reject oversize input before the rest of it arrives
+            if (m_state == State::RequestLine && data.size() - m_pos > kMaxRequestLine) {
+                return fail(414, "URI Too Long");
+            }
+            if (data.size() > kMaxHeadSize) {
+                return fail(431, "Request Header Fields Too Large");
+            }
+            return Result::Incomplete;
+        }
+        if (eol + 1 > kMaxHeadSize) {
+            return fail(431, "Request Header Fields Too Large");
+        }
+
+        size_t lineStart = m_pos;
+        std::string_view line = data.substr(lineStart, eol - lineStart);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        m_pos = eol + 1;
+
+        if (m_state == State::RequestLine) {
+            // Tolerate stray empty lines before the request line (RFC 7230 3.5)
+            if (line.empty()) continue;
+            if (!parseRequestLine(line, lineStart)) return Result::Error;
+            m_state = State::Headers;
+            continue;
+        }
+
+        if (line.empty()) {
+            m_headSize = m_pos;
+            m_state = State::Done;
+            return Result::Complete;
+        }
+        if (!parseHeaderLine(line, lineStart)) return Result::Error;
+    }
+}
+
+bool HttpParser::parseRequestLine(std::string_view line, size_t lineStart) {
+    if (line.size() > kMaxRequestLine) {
+        fail(414, "URI Too Long");
+        return false;
+    }
+
+    size_t sp1 = line.find(' ');
+    size_t sp2 = sp1 == std::string_view::npos ? sp1 : line.find(' ', sp1 + 1);
+    if (sp1 == std::string_view::npos || sp2 == std::string_view::npos ||
+        line.find(' ', sp2 + 1) != std::string_view::npos) {
+        fail(400, "Bad Request");
+        return false;
+    }
+
+    std::string_view method = line.substr(0, sp1);
+    std::string_view target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+    std::string_view version = line.substr(sp2 + 1);
+
+    if (!isToken(method) || target.empty() || (target.front() != '/' && target != "*")) {
+        fail(400, "Bad Request");
+        return false;
+    }
+    if (version != "HTTP/1.1" && version != "HTTP/1.0") {
+        fail(505, "HTTP Version Not Supported");
+        return false;
+    }
+
+    auto span = [lineStart](size_t offset, size_t length) {
+        return Span{static_cast<uint32_t>(lineStart + offset), static_cast<uint32_t>(length)};
+    };
+    m_method = span(0, method.size());
+    m_target = span(sp1 + 1, target.size());
+    m_version = span(sp2 + 1, version.size());
+    return true;
+}
+
+bool HttpParser::parseHeaderLine(std::string_view line, size_t lineStart) {
+    // Obsolete line folding is not accepted (RFC 7230 3.2.4)
+    if (line.front() == ' ' || line.front() == '\t') {
+        fail(400, "Bad Request");
+        return false;
+    }
+
+    size_t colon = line.find(':');
+    if (colon == std::string_view::npos || !isToken(line.substr(0, colon))) {
+        fail(400, "Bad Request");
+        return false;
+    }
+    if (m_headerCount == kMaxHeaders) {
+        fail(431, "Request Header Fields Too Large");
+        return false;
+    }
+
+    std::string_view value = trim(line.substr(colon + 1));
+    size_t valueOffset = value.empty() ? lineStart + line.size() : static_cast<size_t>(value.data() - line.data()) + lineStart;
+
+    HeaderSpan& header = m_headers[m_headerCount++];
+    header.name = Span{static_cast<uint32_t>(lineStart), static_cast<uint32_t>(colon)};
+    header.value = Span{static_cast<uint32_t>(valueOffset), static_cast<uint32_t>(value.size())};
+    return true;
+}
+
+HttpParser::Result HttpParser::fail(int status, const char* reason) {
+    m_state = State::Failed;
+    m_errorStatus = status;
+    m_errorReason = reason;
+    return Result::Error;
+}
+
+std::string_view HttpParser::path() const {
+    std::string_view target = this->target();
+    return target.substr(0, target.find('?'));
+}
+
+std::string_view HttpParser::query() const {
+    std::string_view target = this->target();
+    size_t pos = target.find('?');
+    return pos == std::string_view::npos ? std::string_view() : target.substr(pos + 1);
+}
+
+HttpParser::Header HttpParser::headerAt(size_t index) const {
+    return Header{view(m_headers[index].name), view(m_headers[index].value)};
+}
+
+std::string_view HttpParser::header(std::string_view name) const {
+    for (size_t i = 0; i < m_headerCount; ++i) {
+        if (equalsIgnoreCase(view(m_headers[i].name), name)) {
+            return view(m_headers[i].value);
+        }
+    }
+    return std::string_view();
+}
+
+bool HttpParser::headerHasToken(std::string_view name, std::string_view token) const {
+    // Comma separated list such as "Connection: keep-alive, Upgrade"
+    std::string_view value = header(name);
+    while (!value.empty()) {
+        size_t comma = value.find(',');
+        if (equalsIgnoreCase(trim(value.substr(0, comma)), token)) {
+            return true;
+        }
+        if (comma == std::string_view::npos) break;
+        value.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+bool HttpParser::equalsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// HttpBodyParser implementation
+HttpBodyParser::HttpBodyParser() {
+    reset();
+}
+
+void HttpBodyParser::reset() {
+    m_state = State::Done;
+    m_remaining = 0;
+    m_bodySize = 0;
+    m_sawDigit = false;
+}
+
+void HttpBodyParser::startContentLength(uint64_t length) {
+    reset();
+    m_remaining = length;
+    m_state = length > 0 ? State::Length : State::Done;
+}
+
+void HttpBodyParser::startChunked() {
+    reset();
+    m_state = State::ChunkSize;
+}
+
+HttpBodyParser::Result HttpBodyParser::decode(std::string_view& input, std::string_view& piece) {
+    piece = std::string_view();
+
+    while (true) {
+        switch (m_state) {
+            case State::Done:
+                return Result::Complete;
+            case State::Failed:
+                return Result::Error;
+            case State::Length:
+            case State::ChunkData: {
+                if (input.empty()) return Result::Incomplete;
+                size_t take = static_cast<size_t>(std::min<uint64_t>(m_remaining, input.size()));
+                piece = input.substr(0, take);
+                input.remove_prefix(take);
+                m_remaining -= take;
+                m_bodySize += take;
+                if (m_remaining == 0) {
+                    m_state = m_state == State::Length ? State::Done : State::ChunkDataCR;
+                }
+                return m_state == State::Done ? Result::Complete : Result::Incomplete;
+            }
+            default:
+                break;
+        }
+
+        // Framing bytes are handled one at a time so they may split anywhere
+        if (input.empty()) return Result::Incomplete;
+        char c = input.front();
+        input.remove_prefix(1);
+
+        switch (m_state) {
+            case State::ChunkSize:
+                if (std::isxdigit(static_cast<unsigned char>(c))) {
+                    if (m_remaining > (UINT64_MAX >> 4)) {
+                        m_state = State::Failed;
+                        break;
+                    }
+                    int digit = std::isdigit(static_cast<unsigned char>(c)) ? c - '0' : (std::tolower(c) - 'a' + 10);
+                    m_remaining = (m_remaining << 4) | static_cast<uint64_t>(digit);
+                    m_sawDigit = true;
+                } else if (m_sawDigit && (c == ';' || c == ' ' || c == '\t')) {
+                    m_state = State::ChunkExtension;
+                } else if (m_sawDigit && c == '\r') {
+                    m_state = State::ChunkSizeLF;
+                } else {
+                    m_state = State::Failed;
+                }
+                break;
+            case State::ChunkExtension:
+                if (c == '\r') m_state = State::ChunkSizeLF;
+                break;
+            case State::ChunkSizeLF:
+                if (c != '\n') {
+                    m_state = State::Failed;
+                } else if (m_remaining == 0) {
+                    m_state = State::TrailerLineStart;
+                } else {
+                    m_state = State::ChunkData;
+                }
+                break;
+            case State::ChunkDataCR:
+                m_state = c == '\r' ? State::ChunkDataLF : State::Failed;
+                break;
+            case State::ChunkDataLF:
+                if (c == '\n') {
+                    m_state = State::ChunkSize;
+                    m_sawDigit = false;
+                } else {
+                    m_state = State::Failed;
+                }
+                break;
+            case State::TrailerLineStart:
+                m_state = c == '\r' ? State::TrailerLF : State::TrailerLine;
+                break;
+            case State::TrailerLine:
+                if (c == '\n') m_state = State::TrailerLineStart;
+                break;
+            case State::TrailerLF:
+                m_state = c == '\n' ? State::Done : State::Failed;
+                break;
+            default:
+                break;
+        }
+    }
+}
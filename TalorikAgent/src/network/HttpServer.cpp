@@ -1,44 +1,566 @@
 #include "network/HttpServer.h"
+#include "network/HttpParser.h"
+#include "network/IoUring.h"
+#include "network/HandlerMemory.h"
 #include <sstream>
 #include <regex>
 #include <algorithm>
+#include <array>
+#include <optional>
+#include <charconv>
+#include <cmath>
+#include <deque>
+#include <utility>
+#include <stdexcept>
+#include <filesystem>
+#include <cstring>
+
+#ifdef HAS_IO_URING
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#endif
+
+#ifdef HAS_OPENSSL
+#include <asio/ssl.hpp>
+#endif
+
+namespace {
+    constexpr size_t kReadChunkSize = 4096;
+    constexpr size_t kRetainedBodyCapacity = 64 * 1024;
+    constexpr size_t kArenaSize = 4096;                     // per-connection request arena, enough for typical headers
+    constexpr auto kAcceptRetryDelay = std::chrono::milliseconds(50);
+    constexpr char kContinueResponse[] = "HTTP/1.1 100 Continue\r\n\r\n";
+    constexpr uint64_t kMaxWebSocketPayload = 64 * 1024;    // clients only send control frames
+    constexpr char kEventStreamPreamble[] = "retry: 3000\n\n";
+    constexpr unsigned kRingEntries = 256;
+    constexpr unsigned kRingBuffers = 256;                  // registered receive buffers per worker
+    constexpr size_t kFileChunkSize = 64 * 1024;            // file reads where sendfile() can't be used
+    
+    // Reactor asio was built with, reported when io_uring is not in use
+    const char* reactorName() {
+#if defined(ASIO_HAS_IOCP)
+        return "iocp";
+#elif defined(ASIO_HAS_IO_URING_AS_DEFAULT)
+        return "io_uring";
+#elif defined(ASIO_HAS_EPOLL)
+        return "epoll";
+#elif defined(ASIO_HAS_KQUEUE)
+        return "kqueue";
+#elif defined(ASIO_HAS_DEV_POLL)
+        return "/dev/poll";
+#else
+        return "select";
+#endif
+    }
+    
+    // One SSE event block; multi-line data becomes one "data:" line per line
+    std::string formatEvent(uint64_t id, const std::string& type, const std::string& data) {
+        std::string out;
+        out.reserve(data.size() + type.size() + 40);
+        out.append("id: ").append(std::to_string(id)).append("\nevent: ").append(type).append("\n");
+        size_t start = 0;
+        while (true) {
+            size_t end = data.find('\n', start);
+            out.append("data: ").append(data, start, end == std::string::npos ? std::string::npos : end - start).append("\n");
+            if (end == std::string::npos) break;
+            start = end + 1;
+        }
+        out.append("\n");
+        return out;
+    }
+    
+    constexpr uint64_t kFnvOffset = 14695981039346656037ull;
+    
+    uint64_t fnv1a(uint64_t hash, const unsigned char* bytes, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+        return hash;
+    }
+    
+    // Rate limit identity of a TCP client: FNV-1a over its address bytes
+    uint64_t clientKey(const asio::ip::address& address) {
+        if (address.is_v4()) {
+            auto bytes = address.to_v4().to_bytes();
+            return fnv1a(kFnvOffset, bytes.data(), bytes.size());
+        }
+        auto bytes = address.to_v6().to_bytes();
+        return fnv1a(kFnvOffset, bytes.data(), bytes.size());
+    }
+    
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+    // Rate limit identity of a Unix socket client: its user id, where the
+    // kernel reports it, so local users get a bucket each instead of sharing
+    // 127.0.0.1's with loopback TCP clients. The 5-byte prefix keeps these
+    // keys apart from address ones, which hash 4 or 16 bytes.
+    uint64_t localClientKey(asio::local::stream_protocol::socket& socket) {
+        static constexpr unsigned char kPrefix[] = {'l', 'o', 'c', 'a', 'l'};
+        uint64_t hash = fnv1a(kFnvOffset, kPrefix, sizeof(kPrefix));
+#ifdef SO_PEERCRED
+        ucred credentials{};
+        socklen_t length = sizeof(credentials);
+        if (getsockopt(socket.native_handle(), SOL_SOCKET, SO_PEERCRED, &credentials, &length) == 0) {
+            unsigned char uid[sizeof(credentials.uid)];
+            std::memcpy(uid, &credentials.uid, sizeof(uid));
+            hash = fnv1a(hash, uid, sizeof(uid));
+        }
+#endif
+        return hash;
+    }
+#endif
+    
+    // Bucket key for one client on one route. The route id is hashed in
+    // after the client rather than added on, which let different (client,
+    // route) pairs share a key.
+    uint64_t rateLimitKey(uint64_t client, size_t routeId) {
+        unsigned char bytes[sizeof(routeId)];
+        for (size_t i = 0; i < sizeof(routeId); ++i) {
+            bytes[i] = static_cast<unsigned char>(routeId >> (8 * i));
+        }
+        return fnv1a(client, bytes, sizeof(bytes));
+    }
+    
+    // Peer of a TCP connection, for rate limits and handlers
+    asio::ip::address remoteAddress(const asio::ip::tcp::socket& socket) {
+        asio::error_code ec;
+        return socket.remote_endpoint(ec).address();
+    }
+    
+    // Each coding is its own representation and needs its own validator
+    std::pmr::string encodedETag(std::string_view etag, ContentEncoding encoding, std::pmr::memory_resource* arena) {
+        std::pmr::string encoded(etag.substr(0, etag.size() - 1), arena);
+        encoded.append("-").append(Compression::name(encoding)).append("\"");
+        return encoded;
+    }
+    
+    // "Date: ...\r\n" for the current second. Each worker thread reformats
+    // its copy once a second; every response in between reuses it.
+    std::string_view dateHeader() {
+        thread_local std::time_t formatted = -1;
+        thread_local char line[48];
+        thread_local size_t length = 0;
+        
+        std::time_t now = std::time(nullptr);
+        if (now != formatted) {
+            static const char* const days[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+            static const char* const months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                                 "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+            std::tm tm;
+            gmtime_r(&now, &tm);
+            // IMF-fixdate, spelled out so the locale can't change it
+            length = std::snprintf(line, sizeof(line), "Date: %s, %02d %s %04d %02d:%02d:%02d GMT\r\n",
+                                   days[tm.tm_wday], tm.tm_mday, months[tm.tm_mon], tm.tm_year + 1900,
+                                   tm.tm_hour, tm.tm_min, tm.tm_sec);
+            formatted = now;
+        }
+        return std::string_view(line, length);
+    }
+
+    // Defaults for everything but the port
+    HttpServer::Options portOptions(int port) {
+        HttpServer::Options options;
+        options.port = port;
+        return options;
+    }
+}
 
 // Forward declarations for nested classes
-class HttpServer::Connection {
+
+class HttpServer::HttpResponse {
 public:
-    Connection(asio::ip::tcp::socket socket) : socket_(std::move(socket)) {}
+    // Status text, headers and the formatted head live in arena, normally
+    // the connection's request arena
+    explicit HttpResponse(std::pmr::memory_resource* arena = std::pmr::get_default_resource())
+        : status_text("OK", arena)
+        , headers(arena) {}
     
-    asio::ip::tcp::socket socket_;
-    std::string buffer_;
+    int status_code = 200;
+    std::pmr::string status_text;
+    std::pmr::map<std::pmr::string, std::pmr::string> headers;
+    std::string body;
+    std::shared_ptr<const std::string> sharedBody;  // cached bytes, sent instead of body
+    std::shared_ptr<StaticFiles::OpenFile> file;    // streamed after the head instead of a body
+    std::string_view headerBlock;   // preformatted header lines owned by the server, sent before headers
+    
+    // Bytes that go out after the head
+    const std::string& payload() const { return sharedBody ? *sharedBody : body; }
+    
+    // Indexing headers with a literal builds the key on the default resource,
+    // which allocates once the name outgrows the small string buffer
+    void setHeader(std::string_view name, std::string_view value) {
+        headers.insert_or_assign(std::pmr::string(name, headers.get_allocator()), value);
+    }
+    
+    // Status line and headers; the body is written as a separate buffer.
+    // date and connection are preformatted lines copied as they are, and a
+    // negative contentLength leaves Content-Length out.
+    std::pmr::string head(std::string_view date, std::string_view connection, int64_t contentLength) const;
 };
 
-class HttpServer::HttpRequest {
+// TLS settings shared by every connection; empty without OpenSSL
+class HttpServer::TlsContext {
 public:
-    std::string method;
-    std::string path;
-    std::string version;
-    std::map<std::string, std::string> headers;
-    std::string body;
+#ifdef HAS_OPENSSL
+    explicit TlsContext(const Options& options);
     
-    static HttpRequest parse(const std::string& request);
+    asio::ssl::context context_;
+#endif
 };
 
-class HttpServer::HttpResponse {
+class HttpServer::Worker : public std::enable_shared_from_this<Worker> {
 public:
-    int status_code;
-    std::string status_text;
-    std::map<std::string, std::string> headers;
-    std::string body;
+    Worker() 
+        : ioContext_(1)
+        , acceptor_(ioContext_)
+        , acceptTimer_(ioContext_)
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+        , localAcceptor_(ioContext_)
+        , localAcceptTimer_(ioContext_)
+#endif
+        , heartbeatTimer_(ioContext_)
+        , workGuard_(asio::make_work_guard(ioContext_)) {}
+    
+    HandlerMemory handlerMemory_;   // posts made on the worker's thread; outlives the io_context
+    asio::io_context ioContext_;
+#ifdef HAS_IO_URING
+    std::unique_ptr<IoUring> ring_;     // accepts and request I/O, unless the kernel lacks io_uring
+#endif
+    asio::ip::tcp::acceptor acceptor_;
+    asio::steady_timer acceptTimer_;        // retries accepting once below the cap or after an error
+    bool acceptFailing_ = false;            // an accept error was logged, no success since
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+    asio::local::stream_protocol::acceptor localAcceptor_;  // first worker only, when configured
+    asio::steady_timer localAcceptTimer_;
+    bool localAcceptFailing_ = false;
+#endif
+    asio::steady_timer heartbeatTimer_;
+    asio::executor_work_guard<asio::io_context::executor_type> workGuard_;
+    std::thread thread_;
+    
+    // Push subscribers, only touched from this worker's thread
+    std::vector<std::shared_ptr<Connection>> webSockets_;
+    std::vector<std::shared_ptr<Connection>> eventStreams_;
+    
+    // Complete requests waiting for their handler, one queue per priority
+    struct Pending {
+        std::shared_ptr<Connection> connection;
+        std::chrono::steady_clock::time_point queuedAt;
+    };
+    std::array<std::deque<Pending>, 3> pending_;
+    bool dispatchPosted_ = false;
+    
+    // Queueing delay tracking for shedding (CoDel-style)
+    std::chrono::steady_clock::time_point intervalStart_;
+    std::chrono::steady_clock::duration minDelay_ = std::chrono::steady_clock::duration::max();
+    bool overloaded_ = false;
+};
+
+class HttpServer::Connection {
+public:
+    // TCP and Unix socket connections share one socket type
+    using Socket = asio::generic::stream_protocol::socket;
+    
+    Connection(Socket socket, const asio::ip::address& remoteAddress, Worker& worker, std::shared_ptr<std::atomic<size_t>> activeCount) 
+        : socket_(std::move(socket))
+        , idleTimer_(socket_.get_executor())
+        , deadlineTimer_(socket_.get_executor())
+        , worker_(&worker)
+        , activeCount_(std::move(activeCount))
+        , remoteAddress_(remoteAddress)
+        , clientKey_(clientKey(remoteAddress))
+#ifdef HTTP_COROUTINES
+        , wakeup_(socket_.get_executor(), asio::steady_timer::time_point::max())
+#endif
+        , arena_(arenaBuffer_.data(), arenaBuffer_.size())
+        , response_(&arena_)
+        , responseHead_(&arena_)
+    {
+        // Sized for a full request head so partial reads never reallocate
+        buffer_.reserve(HttpParser::kMaxHeadSize + kReadChunkSize);
+    }
+    
+    // The slot under the connection cap is held until the last handler lets go
+    ~Connection() {
+        (*activeCount_)--;
+    }
+    
+    Socket socket_;
+#ifdef HAS_OPENSSL
+    using TlsStream = asio::ssl::stream<Socket&>;
+    std::unique_ptr<TlsStream> tls_;    // set on HTTPS connections, wraps socket_
+#endif
+    asio::steady_timer idleTimer_;
+    asio::steady_timer deadlineTimer_;  // whole request, then the response write
+    bool deadlineArmed_ = false;
+    Worker* worker_;            // owning io_context, all I/O runs on its thread
+    std::shared_ptr<std::atomic<size_t>> activeCount_;    // shared, a late Responder may outlive the server
+    asio::ip::address remoteAddress_;
+    uint64_t clientKey_;        // rate limit identity
+    bool local_ = false;        // accepted on the Unix socket
+    HandlerMemory handlerMemory_;
+    
+#ifdef HTTP_COROUTINES
+    // In coroutine mode the steps that would start a read or write hand it
+    // to the connection's coroutine instead
+    enum class Step {
+        None,
+        ReadBody,
+        Write
+    };
+    asio::steady_timer wakeup_;     // never expires; cancelled to wake the coroutine
+    bool coroutine_ = false;
+    Step next_ = Step::None;
+    
+    void resume(Step step) {
+        next_ = step;
+        wakeup_.cancel();
+    }
+#endif
+    std::string buffer_;
+    HttpParser parser_;
+    
+    // State of the request whose body is being read
+    std::optional<HttpRequest> request_;
+    Router::Match match_;
+    HttpBodyParser bodyParser_;
+    std::unique_ptr<BodyStream> stream_;
+    std::string body_;          // buffered body for ordinary routes
+    std::string bodyChunk_;     // read buffer while the body arrives
+    size_t bodyOffset_ = 0;     // bytes of buffer_ used by the current request
+    std::string leftover_;      // bytes read past the body, kept while the request waits
+    CacheLookup cacheLookup_;   // strings keep their capacity from one request to the next
+    
+    // Request-scoped memory. The response is built in it and the whole lot
+    // is dropped with one release() once the response is written, so a
+    // steady stream of requests stops hitting malloc.
+    std::array<std::byte, kArenaSize> arenaBuffer_;
+    std::pmr::monotonic_buffer_resource arena_;
+    
+    HttpResponse response_;
+    std::pmr::string responseHead_;
+    uint64_t fileOffset_ = 0;   // bytes of response_.file sent so far
+    std::string fileChunk_;
+    bool keepAlive_ = false;
     
-    std::string toString() const;
+    // Set once upgraded to a WebSocket or turned into an event stream;
+    // pushed frames queue up behind the write in flight
+    bool webSocket_ = false;
+    bool eventStream_ = false;
+    bool closing_ = false;
+    uint64_t lastEventId_ = 0;  // newest event already queued on this stream
+    std::deque<std::shared_ptr<const std::string>> sendQueue_;
+    std::vector<std::shared_ptr<const std::string>> sending_;
+    std::vector<asio::const_buffer> sendBuffers_;
+    
+    bool encrypted() const {
+#ifdef HAS_OPENSSL
+        return tls_ != nullptr;
+#else
+        return false;
+#endif
+    }
+    
+    // Reads and writes through TLS on HTTPS connections. Any completion
+    // token works, so the coroutine awaits the same calls.
+    template <typename Buffers, typename Token>
+    auto asyncReadSome(const Buffers& buffers, Token&& token) {
+#ifdef HAS_OPENSSL
+        if (tls_) {
+            return tls_->async_read_some(buffers, std::forward<Token>(token));
+        }
+#endif
+        return socket_.async_read_some(buffers, std::forward<Token>(token));
+    }
+    
+    template <typename Buffers, typename Token>
+    auto asyncWrite(const Buffers& buffers, Token&& token) {
+#ifdef HAS_OPENSSL
+        if (tls_) {
+            return asio::async_write(*tls_, buffers, std::forward<Token>(token));
+        }
+#endif
+        return asio::async_write(socket_, buffers, std::forward<Token>(token));
+    }
+    
+    // Completion handler whose operation memory comes from handlerMemory_
+    template <typename Handler>
+    auto withMemory(Handler&& handler) {
+        return bindHandlerMemory(handlerMemory_, std::forward<Handler>(handler));
+    }
+    
+    // Socket I/O for requests and responses, through the worker's ring when
+    // it has one. Shutting the socket down ends either kind of read or write.
+    template <typename Handler>
+    void readSome(asio::mutable_buffer buffer, Handler&& handler) {
+#ifdef HAS_IO_URING
+        if (worker_->ring_ && !encrypted()) {
+            worker_->ring_->readSome(socket_.native_handle(), buffer, std::forward<Handler>(handler));
+            return;
+        }
+#endif
+        asyncReadSome(buffer, withMemory(std::forward<Handler>(handler)));
+    }
+    
+    template <typename Handler>
+    void write(const std::array<asio::const_buffer, 2>& buffers, Handler&& handler) {
+#ifdef HAS_IO_URING
+        if (worker_->ring_ && !encrypted()) {
+            worker_->ring_->write(socket_.native_handle(), buffers.data(), buffers.size(), std::forward<Handler>(handler));
+            return;
+        }
+#endif
+        asyncWrite(buffers, withMemory(std::forward<Handler>(handler)));
+    }
+    
+    // Send response_.file after the head. Plain sockets on Linux use
+    // sendfile(), so the bytes go from the page cache to the socket without
+    // a copy; TLS has to encrypt them in user space, so it gets chunks.
+    template <typename Token>
+    auto asyncSendFile(Token&& token) {
+        return asio::async_compose<Token, void(std::error_code)>(
+            [this](auto& self, std::error_code ec = std::error_code(), size_t = 0) {
+                StaticFiles::OpenFile& file = *response_.file;
+                while (!ec && fileOffset_ < file.size()) {
+#ifdef __linux__
+                    if (!encrypted()) {
+                        asio::error_code error;
+                        socket_.native_non_blocking(true, error);
+                        if (error) {
+                            ec = error;
+                            break;
+                        }
+                        off_t offset = static_cast<off_t>(fileOffset_);
+                        size_t count = static_cast<size_t>(std::min<uint64_t>(file.size() - fileOffset_, 0x7ffff000));
+                        ssize_t sent = ::sendfile(socket_.native_handle(), fileno(file.get()), &offset, count);
+                        if (sent > 0) {
+                            fileOffset_ += static_cast<uint64_t>(sent);
+                        } else if (sent == 0) {
+                            ec = asio::error::make_error_code(asio::error::eof);      // the file shrank meanwhile
+                        } else if (errno == EAGAIN) {
+                            socket_.async_wait(Socket::wait_write, std::move(self));
+                            return;
+                        } else if (errno != EINTR) {
+                            ec = std::error_code(errno, std::system_category());
+                        }
+                        continue;
+                    }
+#endif
+                    size_t count = static_cast<size_t>(std::min<uint64_t>(file.size() - fileOffset_, kFileChunkSize));
+                    fileChunk_.resize(count);
+                    if (std::fread(&fileChunk_[0], 1, count, file.get()) != count) {
+                        ec = asio::error::make_error_code(asio::error::eof);
+                        break;
+                    }
+                    fileOffset_ += count;
+                    asyncWrite(asio::buffer(fileChunk_), std::move(self));
+                    return;
+                }
+                
+                // The file is closed as soon as it is sent
+                response_.file.reset();
+                fileChunk_ = std::string();
+                self.complete(ec);
+            },
+            token, socket_);
+    }
+    
+    // Drop the response just written and start the arena over
+    void resetArena() {
+        response_ = HttpResponse(&arena_);
+        responseHead_ = std::pmr::string(&arena_);
+        arena_.release();
+    }
+    
+    void close() {
+        asio::error_code ec;
+        idleTimer_.cancel();
+        deadlineTimer_.cancel();
+#ifdef HTTP_COROUTINES
+        wakeup_.cancel();
+#endif
+#ifdef HAS_IO_URING
+        // Queued ring operations must reach the kernel before the fd is reused
+        if (worker_->ring_) {
+            worker_->ring_->submit();
+        }
+#endif
+        socket_.shutdown(Socket::shutdown_both, ec);
+        socket_.close(ec);
+    }
 };
 
+#ifdef HAS_OPENSSL
+HttpServer::TlsContext::TlsContext(const Options& options)
+    : context_(asio::ssl::context::tls_server) {
+    context_.set_options(asio::ssl::context::default_workarounds |
+                         asio::ssl::context::no_sslv2 |
+                         asio::ssl::context::no_sslv3 |
+                         asio::ssl::context::no_tlsv1 |
+                         asio::ssl::context::no_tlsv1_1 |
+                         asio::ssl::context::single_dh_use);
+    context_.use_certificate_chain_file(options.certificateFile);
+    context_.use_private_key_file(options.privateKeyFile, asio::ssl::context::pem);
+    
+    // Reconnecting clients resume their session instead of doing a full
+    // handshake. Session tickets keep the state on the client, so any worker
+    // can resume one without a shared cache; the server-side cache covers
+    // clients that don't support tickets.
+    SSL_CTX* native = context_.native_handle();
+    static const unsigned char sessionContext[] = "HttpServer";
+    SSL_CTX_set_session_id_context(native, sessionContext, sizeof(sessionContext) - 1);
+    SSL_CTX_set_session_cache_mode(native, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_set_timeout(native, options.tlsSessionTimeout);
+    SSL_CTX_clear_options(native, SSL_OP_NO_TICKET);
+    SSL_CTX_set_num_tickets(native, 1);     // clients reconnect one at a time
+    
+    // Idle keep-alive connections give their record buffers back
+    SSL_CTX_set_mode(native, SSL_MODE_RELEASE_BUFFERS);
+}
+#endif
+
 // HttpServer implementation
 HttpServer::HttpServer(int port) 
-    : m_acceptor(m_ioContext, asio::ip::tcp::endpoint(asio::ip::tcp::v4(), port))
+    : HttpServer(portOptions(port)) {
+}
+
+HttpServer::HttpServer(const Options& options)
+    : m_nextWorker(0)
     , m_running(false)
+    , m_perWorkerAcceptors(false)
+    , m_ioUring(false)
+    , m_activeConnections(std::make_shared<std::atomic<size_t>>(0))
+    , m_acceptedConnections(0)
+    , m_rejectedConnections(0)
+    , m_timedOutConnections(0)
+    , m_shedRequests(0)
+    , m_tlsHandshakes(0)
+    , m_tlsResumptions(0)
     , m_corsEnabled(true)
-    , m_port(port) {
+    , m_webSocketClients(0)
+    , m_eventStreamClients(0)
+    , m_hasEventStreams(false)
+    , m_lastEventId(0)
+    , m_options(options)
+    , m_port(options.port) {
+    // Headers every API response carries, formatted once for each CORS setting
+    std::string common = "Content-Type: application/json\r\n";
+    if (m_options.compression) {
+        common += "Vary: Accept-Encoding\r\n";
+    }
+    m_headerBlocks[0] = common;
+    m_headerBlocks[1] = common +
+        "Access-Control-Allow-Origin: *\r\n"
+        "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n"
+        "Access-Control-Allow-Headers: Content-Type\r\n";
+    m_keepAliveHeaders = "Connection: keep-alive\r\nKeep-Alive: timeout=" +
+        std::to_string(m_options.keepAliveTimeout) + "\r\n";
 }
 
 HttpServer::~HttpServer() {
@@ -48,207 +570,1749 @@ HttpServer::~HttpServer() {
 void HttpServer::start() {
     if (m_running) return;
     
-    m_running = true;
-    Logger::info("Starting HTTP server on port " + std::to_string(m_port));
+    size_t workerCount = m_options.workerThreads > 0
+        ? static_cast<size_t>(m_options.workerThreads)
+        : std::max(1u, std::thread::hardware_concurrency());
     
-    acceptConnection();
+#ifdef SO_REUSEPORT
+    // Every worker binds its own acceptor to the port and the kernel spreads
+    // incoming connections across them, so no lock is shared on accept.
+    m_perWorkerAcceptors = m_options.reusePort;
+#else
+    // Without SO_REUSEPORT the first worker accepts and hands sockets out
+    // round-robin to the other workers' io_contexts.
+    m_perWorkerAcceptors = false;
+#endif
     
-    m_serverThread = std::thread([this]() {
-        try {
-            m_ioContext.run();
-        } catch (const std::exception& e) {
-            Logger::error("HTTP server error: " + std::string(e.what()));
+    // Bad certificate or key files stop the server from starting
+    if (m_options.tls) {
+#ifdef HAS_OPENSSL
+        m_tls = std::make_unique<TlsContext>(m_options);
+#else
+        throw std::runtime_error("TLS requested but HttpServer was built without OpenSSL");
+#endif
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(m_workersMutex);
+        m_workers.clear();
+        for (size_t i = 0; i < workerCount; ++i) {
+            m_workers.push_back(std::make_shared<Worker>());
         }
-    });
+    }
+    
+#ifdef HAS_IO_URING
+    // Kernels without io_uring, or with it blocked, keep the asio reactor
+    m_ioUring = m_options.ioUring;
+    for (size_t i = 0; m_ioUring && i < workerCount; ++i) {
+        auto ring = std::make_unique<IoUring>(m_workers[i]->ioContext_, m_workers[i]->handlerMemory_);
+        std::string error;
+        if (!ring->open(kRingEntries, kRingBuffers, kReadChunkSize, error)) {
+            Logger::warning("io_uring unavailable (" + error + "), using " + reactorName());
+            m_ioUring = false;
+            break;
+        }
+        m_workers[i]->ring_ = std::move(ring);
+    }
+    if (!m_ioUring) {
+        for (auto& worker : m_workers) {
+            worker->ring_.reset();
+        }
+    }
+#endif
+    
+    try {
+        for (size_t i = 0; i < workerCount; ++i) {
+            if (m_perWorkerAcceptors || i == 0) {
+                openAcceptor(*m_workers[i]);
+            }
+        }
+        if (!m_options.unixSocketPath.empty()) {
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+            openLocalAcceptor(*m_workers[0]);
+#else
+            Logger::warning("Unix domain sockets are not supported here, not listening on " + m_options.unixSocketPath);
+#endif
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(m_workersMutex);
+        m_workers.clear();
+        throw;
+    }
+    
+    // Only routes that ask for it, and static file misses, run off the io threads
+    bool offloads = std::any_of(m_routes.begin(), m_routes.end(),
+                                [](const Route& route) { return route.options.offload || route.staticFiles; });
+    if (offloads) {
+        m_handlerPool = std::make_unique<asio::thread_pool>(std::max(1, m_options.handlerThreads));
+    }
+    
+    // File changes are picked up on the first worker's thread
+    for (auto& route : m_routes) {
+        if (route.staticFiles) {
+            route.staticFiles->watch(m_workers[0]->ioContext_);
+        }
+    }
+    
+    m_running = true;
+    Logger::info("Starting HTTP server on port " + std::to_string(m_port) + 
+                 " with " + std::to_string(workerCount) + " worker thread(s) on " + getIoBackend() +
+                 (m_perWorkerAcceptors ? " (SO_REUSEPORT)" : "") + (m_tls ? ", TLS" : ""));
+    
+    for (auto& worker : m_workers) {
+        if (worker->acceptor_.is_open()) {
+            acceptConnection(*worker);
+        }
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+        if (worker->localAcceptor_.is_open()) {
+            Logger::info("HTTP server also listening on " + m_options.unixSocketPath);
+            acceptLocalConnection(*worker);
+        }
+#endif
+        if (m_hasEventStreams) {
+            scheduleHeartbeat(*worker);
+        }
+        
+        Worker* w = worker.get();
+        w->thread_ = std::thread([w]() {
+            try {
+                w->ioContext_.run();
+            } catch (const std::exception& e) {
+                Logger::error("HTTP server error: " + std::string(e.what()));
+            }
+        });
+    }
 }
 
 void HttpServer::stop() {
     if (!m_running) return;
     
     m_running = false;
-    m_ioContext.stop();
+    for (auto& worker : m_workers) {
+        worker->ioContext_.stop();
+    }
+    
+    for (auto& worker : m_workers) {
+        if (worker->thread_.joinable()) {
+            worker->thread_.join();
+        }
+    }
+    
+    // Offloaded handlers still running post their results to the stopped
+    // io_contexts, which must outlive them
+    if (m_handlerPool) {
+        m_handlerPool->join();
+        m_handlerPool.reset();
+    }
+    for (auto& route : m_routes) {
+        if (route.staticFiles) {
+            route.staticFiles->unwatch();
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_workersMutex);
+        m_workers.clear();
+    }
     
-    if (m_serverThread.joinable()) {
-        m_serverThread.join();
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+    if (!m_options.unixSocketPath.empty()) {
+        std::error_code ec;
+        std::filesystem::remove(m_options.unixSocketPath, ec);
     }
+#endif
     
-    Logger::info("HTTP server stopped");
+    Logger::info("HTTP server stopped (" + std::to_string(m_acceptedConnections.load()) + " accepted, " +
+                 std::to_string(m_rejectedConnections.load()) + " rejected, " +
+                 std::to_string(m_timedOutConnections.load()) + " timed out, " +
+                 std::to_string(m_shedRequests.load()) + " shed, " +
+                 std::to_string(m_tlsHandshakes.load()) + " TLS handshakes, " +
+                 std::to_string(m_tlsResumptions.load()) + " resumed)");
 }
 
 void HttpServer::addRoute(const std::string& method, const std::string& path, RequestHandler handler) {
-    m_routes[method][path] = handler;
+    addRoute(method, path, std::move(handler), RouteOptions());
 }
 
-void HttpServer::enableCors(bool enable) {
-    m_corsEnabled = enable;
+void HttpServer::addRoute(const std::string& method, const std::string& path, RequestHandler handler, const RouteOptions& options) {
+    if (m_running) {
+        Logger::warning("Ignoring route added while running: " + method + " " + path);
+        return;
+    }
+    
+    m_router.add(method, path, m_routes.size());
+    m_routes.push_back({method, path, std::move(handler), nullptr, options});
+}
+
+void HttpServer::addAsyncRoute(const std::string& method, const std::string& path, AsyncHandler handler, const RouteOptions& options) {
+    if (m_running) {
+        Logger::warning("Ignoring route added while running: " + method + " " + path);
+        return;
+    }
+    
+    m_router.add(method, path, m_routes.size());
+    Route route{method, path, nullptr, nullptr, options};
+    route.asyncHandler = std::move(handler);
+    m_routes.push_back(std::move(route));
+}
+
+void HttpServer::addStreamingRoute(const std::string& method, const std::string& path, StreamHandler handler) {
+    if (m_running) {
+        Logger::warning("Ignoring route added while running: " + method + " " + path);
+        return;
+    }
+    
+    m_router.add(method, path, m_routes.size());
+    m_routes.push_back({method, path, nullptr, std::move(handler), RouteOptions()});
+}
+
+void HttpServer::addStaticRoute(const std::string& prefix, const std::string& directory, const StaticFiles::Options& options) {
+    if (m_running) {
+        Logger::warning("Ignoring route added while running: GET " + prefix);
+        return;
+    }
+    
+    // "{path*}" takes whatever is left of the path, "" for the prefix itself
+    std::string base = prefix;
+    if (base.empty() || base.back() != '/') {
+        base += '/';
+    }
+    std::string path = base + "{path*}";
+    
+    auto files = std::make_shared<StaticFiles>(directory, options);
+    m_router.add("GET", path, m_routes.size());
+    if (base.size() > 1) {
+        // "/ui" is redirected to "/ui/" so relative links in the index resolve
+        m_router.add("GET", base.substr(0, base.size() - 1), m_routes.size());
+    }
+    Route route{"GET", path, nullptr, nullptr, RouteOptions()};
+    route.staticFiles = std::move(files);
+    m_routes.push_back(std::move(route));
+}
+
+void HttpServer::addWebSocketRoute(const std::string& path) {
+    if (m_running) {
+        Logger::warning("Ignoring route added while running: GET " + path);
+        return;
+    }
+    
+    m_router.add("GET", path, m_routes.size());
+    Route route{"GET", path, nullptr, nullptr, RouteOptions()};
+    route.webSocket = true;
+    m_routes.push_back(std::move(route));
 }
 
-void HttpServer::acceptConnection() {
-    m_acceptor.async_accept(
-        [this](std::error_code ec, asio::ip::tcp::socket socket) {
-            if (!ec) {
-                auto connection = std::make_shared<Connection>(std::move(socket));
-                handleRequest(connection);
+void HttpServer::broadcast(const std::string& message) {
+    if (!m_running || m_webSocketClients == 0) return;
+    
+    auto frame = std::make_shared<const std::string>(WebSocket::encodeFrame(WebSocket::Opcode::Text, message));
+    
+    // Held while posting so stop() can't free a worker under us; posting to
+    // a worker that is already stopping is harmless
+    std::lock_guard<std::mutex> lock(m_workersMutex);
+    for (auto& worker : m_workers) {
+        Worker* w = worker.get();
+        asio::post(w->ioContext_, [this, w, frame]() {
+            // Walk backwards: a dropped client is swapped out from behind us
+            for (size_t i = w->webSockets_.size(); i-- > 0;) {
+                pushFrame(w->webSockets_[i], frame);
             }
-            acceptConnection();
         });
+    }
 }
 
-void HttpServer::handleRequest(std::shared_ptr<Connection> connection) {
-    auto& socket = connection->socket_;
+void HttpServer::addEventStreamRoute(const std::string& path) {
+    if (m_running) {
+        Logger::warning("Ignoring route added while running: GET " + path);
+        return;
+    }
     
-    asio::async_read_until(socket, asio::dynamic_buffer(connection->buffer_), "\r\n\r\n",
-        [this, connection](std::error_code ec, std::size_t bytes_transferred) {
-            if (!ec) {
-                try {
-                    // Parse the request
-                    HttpRequest request = HttpRequest::parse(connection->buffer_);
-                    
-                    // Find handler
-                    auto methodIt = m_routes.find(request.method);
-                    if (methodIt != m_routes.end()) {
-                        auto pathIt = methodIt->second.find(request.path);
-                        if (pathIt != methodIt->second.end()) {
-                            // Extract query parameters
-                            std::map<std::string, std::string> params;
-                            std::string cleanPath = parseUrl(request.path, params);
-                            
-                            // Call handler
-                            std::string responseBody = pathIt->second(cleanPath, params);
-                            
-                            // Create response
-                            HttpResponse response;
-                            response.status_code = 200;
-                            response.status_text = "OK";
-                            response.headers["Content-Type"] = "application/json";
-                            response.headers["Content-Length"] = std::to_string(responseBody.length());
-                            
-                            if (m_corsEnabled) {
-                                response.headers["Access-Control-Allow-Origin"] = "*";
-                                response.headers["Access-Control-Allow-Methods"] = "GET, POST, OPTIONS";
-                                response.headers["Access-Control-Allow-Headers"] = "Content-Type";
-                            }
-                            
-                            response.body = responseBody;
-                            
-                            // Send response
-                            std::string responseStr = response.toString();
-                            asio::async_write(connection->socket_, asio::buffer(responseStr),
-                                [connection](std::error_code ec, std::size_t) {
-                                    if (ec) {
-                                        Logger::error("Failed to send response: " + ec.message());
-                                    }
-                                });
-                        } else {
-                            // 404 Not Found
-                            HttpResponse response;
-                            response.status_code = 404;
-                            response.status_text = "Not Found";
-                            response.body = "{\"error\": \"Endpoint not found\"}";
-                            response.headers["Content-Type"] = "application/json";
-                            
-                            std::string responseStr = response.toString();
-                            asio::write(connection->socket_, asio::buffer(responseStr));
-                        }
-                    } else {
-                        // 405 Method Not Allowed
-                        HttpResponse response;
-                        response.status_code = 405;
-                        response.status_text = "Method Not Allowed";
-                        response.body = "{\"error\": \"Method not allowed\"}";
-                        response.headers["Content-Type"] = "application/json";
-                        
-                        std::string responseStr = response.toString();
-                        asio::write(connection->socket_, asio::buffer(responseStr));
-                    }
-                } catch (const std::exception& e) {
-                    Logger::error("Request parsing error: " + std::string(e.what()));
-                    
-                    // Send 500 error
-                    HttpResponse response;
-                    response.status_code = 500;
-                    response.status_text = "Internal Server Error";
-                    response.body = "{\"error\": \"Internal server error\"}";
-                    response.headers["Content-Type"] = "application/json";
-                    
-                    std::string responseStr = response.toString();
-                    asio::write(connection->socket_, asio::buffer(responseStr));
+    m_router.add("GET", path, m_routes.size());
+    Route route{"GET", path, nullptr, nullptr, RouteOptions()};
+    route.eventStream = true;
+    m_routes.push_back(std::move(route));
+    m_hasEventStreams = true;
+}
+
+void HttpServer::publishEvent(const std::string& type, const std::string& data) {
+    Event event;
+    {
+        std::lock_guard<std::mutex> lock(m_eventMutex);
+        event.id = ++m_lastEventId;
+        event.frame = std::make_shared<const std::string>(formatEvent(event.id, type, data));
+        m_eventReplay.push_back(event);
+        while (m_eventReplay.size() > m_options.eventReplayWindow) {
+            m_eventReplay.pop_front();
+        }
+    }
+    
+    if (!m_running || m_eventStreamClients == 0) return;
+    
+    // Same rule as broadcast(): stop() can't free a worker while we post
+    std::lock_guard<std::mutex> lock(m_workersMutex);
+    for (auto& worker : m_workers) {
+        Worker* w = worker.get();
+        asio::post(w->ioContext_, [this, w, event]() {
+            for (size_t i = w->eventStreams_.size(); i-- > 0;) {
+                auto& connection = w->eventStreams_[i];
+                // Skip events a stream already got while replaying
+                if (event.id > connection->lastEventId_) {
+                    connection->lastEventId_ = event.id;
+                    pushFrame(connection, event.frame);
                 }
             }
         });
+    }
+}
+
+void HttpServer::enableCors(bool enable) {
+    m_corsEnabled = enable;
+}
+
+int HttpServer::getWorkerCount() const {
+    std::lock_guard<std::mutex> lock(m_workersMutex);
+    return static_cast<int>(m_workers.size());
+}
+
+std::string HttpServer::getIoBackend() const {
+    return m_ioUring ? "io_uring" : reactorName();
+}
+
+HttpServer::Stats HttpServer::getStats() const {
+    Stats stats;
+    stats.activeConnections = *m_activeConnections;
+    stats.acceptedConnections = m_acceptedConnections;
+    stats.rejectedConnections = m_rejectedConnections;
+    stats.timedOutConnections = m_timedOutConnections;
+    stats.shedRequests = m_shedRequests;
+    stats.tlsHandshakes = m_tlsHandshakes;
+    stats.tlsResumptions = m_tlsResumptions;
+    return stats;
+}
+
+size_t HttpServer::getWebSocketClientCount() const {
+    return m_webSocketClients;
+}
+
+size_t HttpServer::getEventStreamClientCount() const {
+    return m_eventStreamClients;
+}
+
+void HttpServer::openAcceptor(Worker& worker) {
+    asio::ip::tcp::endpoint endpoint(asio::ip::tcp::v4(), m_port);
+    auto& acceptor = worker.acceptor_;
+    
+    acceptor.open(endpoint.protocol());
+    acceptor.set_option(asio::ip::tcp::acceptor::reuse_address(true));
+#ifdef SO_REUSEPORT
+    if (m_perWorkerAcceptors) {
+        using reuse_port = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+        acceptor.set_option(reuse_port(true));
+    }
+#endif
+    acceptor.bind(endpoint);
+    acceptor.listen();
+}
+
+HttpServer::Worker& HttpServer::nextWorker() {
+    return *m_workers[m_nextWorker++ % m_workers.size()];
 }
 
-std::string HttpServer::parseUrl(const std::string& url, std::map<std::string, std::string>& params) {
-    size_t queryPos = url.find('?');
-    if (queryPos == std::string::npos) {
-        return url;
+void HttpServer::acceptConnection(Worker& worker) {
+    // At the cap, stop accepting and let new connections wait in the listen
+    // backlog; check again shortly
+    if (m_options.maxConnections > 0 && *m_activeConnections >= m_options.maxConnections) {
+        worker.acceptTimer_.expires_after(kAcceptRetryDelay);
+        worker.acceptTimer_.async_wait([this, &worker](std::error_code ec) {
+            if (!ec && m_running) {
+                acceptConnection(worker);
+            }
+        });
+        return;
     }
     
-    std::string path = url.substr(0, queryPos);
-    std::string query = url.substr(queryPos + 1);
+#ifdef HAS_IO_URING
+    // One multishot accept keeps handing over connections until it is cancelled
+    if (m_perWorkerAcceptors && worker.ring_) {
+        worker.ring_->acceptMultishot(worker.acceptor_.native_handle(),
+            [this, &worker](std::error_code ec, int fd, bool more) {
+                if (!ec) {
+                    acceptSucceeded(worker.acceptFailing_);
+                    asio::ip::tcp::socket socket(worker.ioContext_);
+                    asio::error_code assignError;
+                    socket.assign(asio::ip::tcp::v4(), fd, assignError);
+                    if (assignError) {
+                        ::close(fd);
+                    } else if (admitConnection()) {
+                        asio::ip::address address = remoteAddress(socket);
+                        startConnection(std::make_shared<Connection>(std::move(socket), address, worker, m_activeConnections));
+                    }
+                }
+                
+                if (!more) {
+                    // A cancel at the cap ends it too; anything else is an error
+                    if (!m_running) {
+                        return;
+                    }
+                    if (ec && ec != std::errc::operation_canceled) {
+                        acceptFailed(worker.acceptTimer_, worker.acceptFailing_, ec, [this, &worker]() {
+                            acceptConnection(worker);
+                        });
+                    } else {
+                        acceptConnection(worker);
+                    }
+                } else if (m_options.maxConnections > 0 && *m_activeConnections >= m_options.maxConnections) {
+                    // Stop at the cap; acceptConnection waits and starts again
+                    worker.ring_->cancelAccept();
+                }
+            });
+        return;
+    }
+#endif
     
-    // Parse query parameters
-    std::istringstream iss(query);
-    std::string param;
-    while (std::getline(iss, param, '&')) {
-        size_t equalPos = param.find('=');
-        if (equalPos != std::string::npos) {
-            std::string key = param.substr(0, equalPos);
-            std::string value = param.substr(equalPos + 1);
-            params[key] = value;
-        }
+    if (m_perWorkerAcceptors) {
+        worker.acceptor_.async_accept(
+            [this, &worker](std::error_code ec, asio::ip::tcp::socket socket) {
+                if (ec) {
+                    if (m_running) {
+                        acceptFailed(worker.acceptTimer_, worker.acceptFailing_, ec, [this, &worker]() {
+                            acceptConnection(worker);
+                        });
+                    }
+                    return;
+                }
+                acceptSucceeded(worker.acceptFailing_);
+                if (admitConnection()) {
+                    asio::ip::address address = remoteAddress(socket);
+                    auto connection = std::make_shared<Connection>(std::move(socket), address, worker, m_activeConnections);
+                    startConnection(connection);
+                }
+                if (m_running) {
+                    acceptConnection(worker);
+                }
+            });
+        return;
     }
     
-    return path;
+    Worker& target = nextWorker();
+    worker.acceptor_.async_accept(target.ioContext_,
+        [this, &worker, &target](std::error_code ec, asio::ip::tcp::socket socket) {
+            if (ec) {
+                if (m_running) {
+                    acceptFailed(worker.acceptTimer_, worker.acceptFailing_, ec, [this, &worker]() {
+                        acceptConnection(worker);
+                    });
+                }
+                return;
+            }
+            acceptSucceeded(worker.acceptFailing_);
+            if (admitConnection()) {
+                asio::ip::address address = remoteAddress(socket);
+                auto connection = std::make_shared<Connection>(std::move(socket), address, target, m_activeConnections);
+                asio::post(target.ioContext_, [this, connection]() {
+                    startConnection(connection);
+                });
+            }
+            if (m_running) {
+                acceptConnection(worker);
+            }
+        });
 }
 
-// HttpRequest implementation
-HttpRequest HttpRequest::parse(const std::string& request) {
-    HttpRequest req;
-    std::istringstream iss(request);
-    std::string line;
-    
-    // Parse request line
-    if (std::getline(iss, line)) {
-        std::istringstream lineStream(line);
-        lineStream >> req.method >> req.path >> req.version;
-    }
-    
-    // Parse headers
-    while (std::getline(iss, line) && line != "\r") {
-        size_t colonPos = line.find(':');
-        if (colonPos != std::string::npos) {
-            std::string key = line.substr(0, colonPos);
-            std::string value = line.substr(colonPos + 1);
-            
-            // Remove leading/trailing whitespace
-            value.erase(0, value.find_first_not_of(" \t"));
-            value.erase(value.find_last_not_of(" \t\r") + 1);
-            
-            req.headers[key] = value;
+// Errors such as EMFILE leave the connection waiting in the backlog, so
+// accepting again straight away would fail the same way in a busy loop.
+// The first failure of a run is logged and each retry waits a little.
+void HttpServer::acceptFailed(asio::steady_timer& timer, bool& failing, const std::error_code& ec,
+                              std::function<void()> retry) {
+    if (!failing) {
+        failing = true;
+        Logger::warning("Accepting connections failed, retrying every " +
+                        std::to_string(kAcceptRetryDelay.count()) + " ms: " + ec.message());
+    }
+    timer.expires_after(kAcceptRetryDelay);
+    timer.async_wait([this, retry = std::move(retry)](std::error_code ec) {
+        if (!ec && m_running) {
+            retry();
         }
+    });
+}
+
+void HttpServer::acceptSucceeded(bool& failing) {
+    if (failing) {
+        failing = false;
+        Logger::info("Accepting connections again");
+    }
+}
+
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+void HttpServer::openLocalAcceptor(Worker& worker) {
+    // A socket file left behind by an earlier run would make bind fail
+    std::error_code ec;
+    if (std::filesystem::is_socket(m_options.unixSocketPath, ec)) {
+        std::filesystem::remove(m_options.unixSocketPath, ec);
     }
     
-    return req;
+    asio::local::stream_protocol::endpoint endpoint(m_options.unixSocketPath);
+    auto& acceptor = worker.localAcceptor_;
+    acceptor.open(endpoint.protocol());
+    acceptor.bind(endpoint);
+    acceptor.listen();
+    
+    // Who may connect is decided by the file's permissions
+    std::filesystem::permissions(m_options.unixSocketPath,
+                                 static_cast<std::filesystem::perms>(m_options.unixSocketMode), ec);
+    if (ec) {
+        Logger::warning("Could not set permissions on " + m_options.unixSocketPath + ": " + ec.message());
+    }
 }
 
-// HttpResponse implementation
-std::string HttpResponse::toString() const {
-    std::ostringstream oss;
+void HttpServer::acceptLocalConnection(Worker& worker) {
+    if (m_options.maxConnections > 0 && *m_activeConnections >= m_options.maxConnections) {
+        worker.localAcceptTimer_.expires_after(kAcceptRetryDelay);
+        worker.localAcceptTimer_.async_wait([this, &worker](std::error_code ec) {
+            if (!ec && m_running) {
+                acceptLocalConnection(worker);
+            }
+        });
+        return;
+    }
     
-    // Status line
-    oss << "HTTP/1.1 " << status_code << " " << status_text << "\r\n";
+    // Local clients are spread over the workers like TCP ones
+    Worker& target = nextWorker();
+    worker.localAcceptor_.async_accept(target.ioContext_,
+        [this, &worker, &target](std::error_code ec, asio::local::stream_protocol::socket socket) {
+            if (ec) {
+                if (m_running) {
+                    acceptFailed(worker.localAcceptTimer_, worker.localAcceptFailing_, ec, [this, &worker]() {
+                        acceptLocalConnection(worker);
+                    });
+                }
+                return;
+            }
+            acceptSucceeded(worker.localAcceptFailing_);
+            if (admitConnection()) {
+                // Handlers see clients on this host as loopback; rate limits
+                // key them by user instead
+                uint64_t client = localClientKey(socket);
+                auto connection = std::make_shared<Connection>(std::move(socket), asio::ip::address_v4::loopback(),
+                                                               target, m_activeConnections);
+                connection->clientKey_ = client;
+                connection->local_ = true;
+                asio::post(target.ioContext_, [this, connection]() {
+                    startConnection(connection);
+                });
+            }
+            if (m_running) {
+                acceptLocalConnection(worker);
+            }
+        });
+}
+#endif
+
+void HttpServer::startConnection(std::shared_ptr<Connection> connection) {
+#ifdef HAS_OPENSSL
+    // HTTPS connections handshake first, within the request deadline.
+    // Unix socket clients are on this host and talk plain HTTP.
+    if (m_tls && !connection->tls_ && !connection->local_) {
+        connection->tls_ = std::make_unique<Connection::TlsStream>(connection->socket_, m_tls->context_);
+        
+        // TLS writes go out a record at a time, and Nagle would hold each
+        // one back until the previous one is acknowledged
+        asio::error_code ec;
+        connection->socket_.set_option(asio::ip::tcp::no_delay(true), ec);
+        armDeadline(connection);
+        connection->tls_->async_handshake(asio::ssl::stream_base::server,
+            [this, connection](std::error_code ec) {
+                cancelDeadline(*connection);
+                if (ec) {
+                    Logger::debug("TLS handshake failed: " + ec.message());
+                    connection->close();
+                    return;
+                }
+                
+                if (SSL_session_reused(connection->tls_->native_handle())) {
+                    m_tlsResumptions++;
+                } else {
+                    m_tlsHandshakes++;
+                }
+                startConnection(connection);
+            });
+        return;
+    }
+#endif
     
-    // Headers
-    for (const auto& header : headers) {
-        oss << header.first << ": " << header.second << "\r\n";
+#ifdef HTTP_COROUTINES
+    if (m_options.coroutines) {
+        auto executor = connection->socket_.get_executor();
+        asio::co_spawn(executor, serveConnection(std::move(connection)), asio::detached);
+        return;
+    }
+#endif
+    readRequest(connection);
+}
+
+bool HttpServer::admitConnection() {
+    // Other workers may have taken the last slots since the accept was
+    // started. A refused socket is closed when the accept handler drops it.
+    size_t active = ++*m_activeConnections;
+    if (m_options.maxConnections > 0 && active > m_options.maxConnections) {
+        (*m_activeConnections)--;
+        m_rejectedConnections++;
+        return false;
     }
     
-    // Empty line
-    oss << "\r\n";
+    m_acceptedConnections++;
+    return true;
+}
+
+void HttpServer::armDeadline(std::shared_ptr<Connection> connection) {
+    if (connection->deadlineArmed_) return;
     
-    // Body
-    oss << body;
+    connection->deadlineArmed_ = true;
+    connection->deadlineTimer_.expires_after(std::chrono::seconds(m_options.requestTimeout));
+    connection->deadlineTimer_.async_wait(connection->withMemory([this, connection](std::error_code ec) {
+        if (!ec) {
+            m_timedOutConnections++;
+            Logger::debug("Closing connection that missed its request deadline");
+            connection->close();
+        }
+    }));
+}
+
+void HttpServer::cancelDeadline(Connection& connection) {
+    connection.deadlineArmed_ = false;
+    connection.deadlineTimer_.cancel();
+}
+
+void HttpServer::armIdleTimer(std::shared_ptr<Connection> connection) {
+    connection->idleTimer_.expires_after(std::chrono::seconds(m_options.keepAliveTimeout));
+    connection->idleTimer_.async_wait(connection->withMemory([connection](std::error_code ec) {
+        if (!ec) {
+            connection->close();
+        }
+    }));
+}
+
+void HttpServer::readRequest(std::shared_ptr<Connection> connection) {
+    // A pipelined request may already be sitting in the buffer
+    if (!connection->buffer_.empty() && processRequest(connection)) {
+        return;
+    }
+    
+    // Close connections that sit idle between requests
+    armIdleTimer(connection);
+    
+    size_t used = connection->buffer_.size();
+    connection->buffer_.resize(used + kReadChunkSize);
+    connection->readSome(asio::buffer(&connection->buffer_[used], kReadChunkSize),
+        [this, connection, used](std::error_code ec, std::size_t bytes_transferred) {
+            connection->idleTimer_.cancel();
+            connection->buffer_.resize(used + bytes_transferred);
+            if (ec) {
+                connection->close();
+                return;
+            }
+            
+            // The request deadline runs from its first byte, so a client
+            // trickling a head or body can't hold the connection forever
+            armDeadline(connection);
+            if (!processRequest(connection)) {
+                readRequest(connection);
+            }
+        });
+}
+
+bool HttpServer::processRequest(std::shared_ptr<Connection> connection) {
+    auto& parser = connection->parser_;
+    HttpParser::Result result = parser.parse(connection->buffer_);
+    if (result == HttpParser::Result::Incomplete) {
+        return false;
+    }
+    
+    if (result == HttpParser::Result::Error) {
+        // Malformed or oversize head, answer and drop the connection
+        failRequest(connection, parser.errorStatus(), parser.errorReason());
+        return true;
+    }
+    
+    HttpRequest& request = connection->request_.emplace(parser, &connection->arena_);
+    request.remoteAddress = connection->remoteAddress_;
+    connection->keepAlive_ = request.wantsKeepAlive() && m_running;
+    connection->bodyOffset_ = parser.headSize();
+    
+    // Find handler; path parameters are captured first, query ones after
+    connection->match_ = m_router.match(request.method, request.path, request.params);
+    bool found = connection->match_.status == Router::MatchStatus::Found;
+    if (found) {
+        request.params.parseQuery(request.query);
+    }
+    
+    // Work out how the body is framed
+    std::string_view transferEncoding = request.header("Transfer-Encoding");
+    std::string_view contentLength = request.header("Content-Length");
+    uint64_t length = 0;
+    bool hasBody = false;
+    if (!transferEncoding.empty()) {
+        // Both framings at once is a request smuggling pattern, refuse it
+        if (!contentLength.empty() || !HttpParser::equalsIgnoreCase(transferEncoding, "chunked")) {
+            failRequest(connection, 400, "Bad Request");
+            return true;
+        }
+        connection->bodyParser_.startChunked();
+        hasBody = true;
+    } else if (!contentLength.empty()) {
+        auto [end, ec] = std::from_chars(contentLength.data(), contentLength.data() + contentLength.size(), length);
+        if (ec != std::errc() || end != contentLength.data() + contentLength.size()) {
+            failRequest(connection, 400, "Bad Request");
+            return true;
+        }
+        connection->bodyParser_.startContentLength(length);
+        hasBody = length > 0;
+    } else {
+        connection->bodyParser_.startContentLength(0);
+    }
+    
+    // Clients over their rate are turned away before any body is read
+    double retryAfter = 0;
+    if (found && !allowRequest(connection->clientKey_, connection->match_.routeId, retryAfter)) {
+        HttpResponse response = errorResponse(429, "Too Many Requests", "Rate limit exceeded");
+        response.headers["Retry-After"] = std::to_string(std::max(1, static_cast<int>(std::ceil(retryAfter))));
+        connection->keepAlive_ = connection->keepAlive_ && !hasBody;
+        rejectRequest(connection, std::move(response));
+        return true;
+    }
+    
+    if (!hasBody) {
+        finishRequest(connection, std::string_view());
+        return true;
+    }
+    
+    // Nobody wants the body of an unrouted request; answer and close
+    if (!found) {
+        connection->keepAlive_ = false;
+        finishRequest(connection, std::string_view());
+        return true;
+    }
+    
+    const Route& route = m_routes[connection->match_.routeId];
+    if (route.streamHandler) {
+        try {
+            connection->stream_ = route.streamHandler(request);
+        } catch (const std::exception& e) {
+            Logger::error("Request handling error: " + std::string(e.what()));
+            failRequest(connection, 500, "Internal Server Error");
+            return true;
+        }
+    } else if (length > m_options.maxBodySize) {
+        failRequest(connection, 413, "Payload Too Large");
+        return true;
+    } else {
+        connection->body_.reserve(static_cast<size_t>(length));
+    }
+    
+    // Body bytes that arrived together with the head
+    std::string_view input(connection->buffer_);
+    input.remove_prefix(connection->bodyOffset_);
+    size_t available = input.size();
+    HttpBodyParser::Result bodyResult = consumeBody(connection, input);
+    if (bodyResult == HttpBodyParser::Result::Error) {
+        return true;
+    }
+    connection->bodyOffset_ += available - input.size();
+    
+    if (bodyResult == HttpBodyParser::Result::Complete) {
+        finishRequest(connection, std::string_view());
+    } else {
+        // Clients waiting on "Expect: 100-continue" get the go-ahead first
+        if (available == 0 && HttpParser::equalsIgnoreCase(request.header("Expect"), "100-continue")) {
+            connection->asyncWrite(asio::buffer(kContinueResponse, sizeof(kContinueResponse) - 1),
+                [this, connection](std::error_code ec, std::size_t) {
+                    if (ec) {
+                        connection->close();
+                        return;
+                    }
+                    readBody(connection);
+                });
+        } else {
+            readBody(connection);
+        }
+    }
+    return true;
+}
+
+void HttpServer::readBody(std::shared_ptr<Connection> connection) {
+#ifdef HTTP_COROUTINES
+    if (connection->coroutine_) {
+        connection->resume(Connection::Step::ReadBody);
+        return;
+    }
+#endif
+    
+    armDeadline(connection);
+    armIdleTimer(connection);
+    
+    // The body is read into its own buffer so views into the head stay valid
+    connection->bodyChunk_.resize(kReadChunkSize);
+    connection->readSome(asio::buffer(connection->bodyChunk_),
+        [this, connection](std::error_code ec, std::size_t bytes_transferred) {
+            connection->idleTimer_.cancel();
+            if (ec) {
+                connection->close();
+                return;
+            }
+            
+            std::string_view input(connection->bodyChunk_.data(), bytes_transferred);
+            HttpBodyParser::Result result = consumeBody(connection, input);
+            if (result == HttpBodyParser::Result::Complete) {
+                // Whatever follows the body belongs to the next request
+                finishRequest(connection, input);
+            } else if (result == HttpBodyParser::Result::Incomplete) {
+                readBody(connection);
+            }
+        });
+}
+
+HttpBodyParser::Result HttpServer::consumeBody(std::shared_ptr<Connection> connection, std::string_view& input) {
+    while (true) {
+        std::string_view piece;
+        HttpBodyParser::Result result = connection->bodyParser_.decode(input, piece);
+        
+        if (!piece.empty()) {
+            if (connection->stream_) {
+                if (connection->bodyParser_.bodySize() > m_options.maxStreamBodySize) {
+                    failRequest(connection, 413, "Payload Too Large");
+                    return HttpBodyParser::Result::Error;
+                }
+                try {
+                    connection->stream_->onChunk(piece);
+                } catch (const std::exception& e) {
+                    Logger::error("Request handling error: " + std::string(e.what()));
+                    failRequest(connection, 500, "Internal Server Error");
+                    return HttpBodyParser::Result::Error;
+                }
+            } else {
+                if (connection->body_.size() + piece.size() > m_options.maxBodySize) {
+                    failRequest(connection, 413, "Payload Too Large");
+                    return HttpBodyParser::Result::Error;
+                }
+                connection->body_.append(piece);
+            }
+        }
+        
+        if (result == HttpBodyParser::Result::Error) {
+            failRequest(connection, 400, "Bad Request");
+            return result;
+        }
+        if (result == HttpBodyParser::Result::Complete || input.empty()) {
+            return result;
+        }
+    }
+}
+
+void HttpServer::finishRequest(std::shared_ptr<Connection> connection, std::string_view leftover) {
+    // The leftover view points into the read buffer, so hold on to a copy
+    connection->leftover_.assign(leftover.data(), leftover.size());
+    
+    // Requests are queued and run from a posted handler, so requests that
+    // became ready together are dispatched in priority order
+    const Router::Match& match = connection->match_;
+    Priority priority = match.status == Router::MatchStatus::Found
+        ? m_routes[match.routeId].options.priority
+        : Priority::High;
+    
+    Worker& worker = *connection->worker_;
+    worker.pending_[static_cast<size_t>(priority)].push_back({connection, std::chrono::steady_clock::now()});
+    if (!worker.dispatchPosted_) {
+        worker.dispatchPosted_ = true;
+        asio::post(worker.ioContext_, bindHandlerMemory(worker.handlerMemory_, [this, &worker]() {
+            dispatchPending(worker);
+        }));
+    }
+}
+
+void HttpServer::dispatchPending(Worker& worker) {
+    worker.dispatchPosted_ = false;
+    
+    for (size_t i = 0; i < worker.pending_.size(); ++i) {
+        auto& queue = worker.pending_[i];
+        if (queue.empty()) continue;
+        
+        Worker::Pending next = std::move(queue.front());
+        queue.pop_front();
+        
+        // One request per turn so I/O that arrived meanwhile, possibly
+        // carrying higher priority requests, gets processed in between
+        bool more = std::any_of(worker.pending_.begin(), worker.pending_.end(),
+                                [](const auto& q) { return !q.empty(); });
+        if (more) {
+            worker.dispatchPosted_ = true;
+            asio::post(worker.ioContext_, bindHandlerMemory(worker.handlerMemory_, [this, &worker]() {
+                dispatchPending(worker);
+            }));
+        } else {
+            // Nothing standing in the queue
+            worker.minDelay_ = std::chrono::steady_clock::duration::zero();
+        }
+        
+        auto delay = std::chrono::steady_clock::now() - next.queuedAt;
+        runRequest(next.connection, shouldShed(worker, static_cast<Priority>(i), delay));
+        return;
+    }
+}
+
+bool HttpServer::shouldShed(Worker& worker, Priority priority, std::chrono::steady_clock::duration delay) {
+    // CoDel's signal: if even the shortest wait over an interval is above
+    // target, the queue is standing rather than absorbing a burst
+    auto now = std::chrono::steady_clock::now();
+    auto target = std::chrono::milliseconds(m_options.shedTarget);
+    auto interval = std::chrono::milliseconds(m_options.shedInterval);
+    
+    worker.minDelay_ = std::min(worker.minDelay_, delay);
+    if (now - worker.intervalStart_ >= interval) {
+        worker.overloaded_ = worker.minDelay_ > target;
+        worker.minDelay_ = std::chrono::steady_clock::duration::max();
+        worker.intervalStart_ = now;
+    }
+    
+    // While overloaded, Low requests may wait no longer than the target and
+    // Normal ones no longer than an interval; High always runs
+    if (!worker.overloaded_ || priority == Priority::High) {
+        return false;
+    }
+    return delay > (priority == Priority::Low ? target : interval);
+}
+
+void HttpServer::runRequest(std::shared_ptr<Connection> connection, bool shed) {
+    HttpRequest& request = *connection->request_;
+    request.body = connection->body_;
+    
+    const Router::Match& match = connection->match_;
+    bool found = match.status == Router::MatchStatus::Found;
+    
+    // Hold a concurrency slot while the handler runs
+    std::atomic<size_t>* inFlight = nullptr;
+    if (found && !shed) {
+        const Route& route = m_routes[match.routeId];
+        inFlight = route.inFlight.get();
+        size_t running = ++*inFlight;
+        shed = route.options.maxConcurrent > 0 && running > route.options.maxConcurrent;
+    }
+    
+    HttpResponse response(&connection->arena_);
+    try {
+        if (shed) {
+            m_shedRequests++;
+            response = errorResponse(503, "Service Unavailable", "Server overloaded");
+            response.headers["Retry-After"] = "1";
+        } else if (found && m_routes[match.routeId].webSocket) {
+            response = webSocketHandshake(request, *connection);
+        } else if (found && m_routes[match.routeId].eventStream) {
+            response = eventStreamResponse(request, *connection);
+        } else if (found && m_routes[match.routeId].staticFiles) {
+            if (!staticFileResponse(request, *m_routes[match.routeId].staticFiles, response)) {
+                // A cache miss needs the disk; completes later from the
+                // handler pool, which releases the slot
+                findStaticFile(connection, inFlight);
+                return;
+            }
+        } else if (found && (m_routes[match.routeId].asyncHandler || m_routes[match.routeId].options.offload)) {
+            // Completes later from runAsync, which releases the slot
+            runAsync(connection, inFlight);
+            return;
+        } else {
+            response = handleRequest(request, match, connection->stream_.get(), connection->cacheLookup_);
+        }
+    } catch (const std::exception& e) {
+        Logger::error("Request handling error: " + std::string(e.what()));
+        response = errorResponse(500, "Internal Server Error", "Internal server error");
+        connection->keepAlive_ = false;
+    }
+    if (inFlight) {
+        (*inFlight)--;
+    }
+    
+    completeRequest(connection, std::move(response));
+}
+
+void HttpServer::runAsync(std::shared_ptr<Connection> connection, std::atomic<size_t>* inFlight) {
+    HttpRequest& request = *connection->request_;
+    const Route& route = m_routes[connection->match_.routeId];
+    
+    // Rejected requests and cache hits need no handler, so they are
+    // answered right here
+    HttpResponse answered(&connection->arena_);
+    if (!validateRequest(request, connection->match_.routeId, answered) ||
+        lookupCache(request, connection->match_.routeId, connection->cacheLookup_, answered)) {
+        (*inFlight)--;
+        completeRequest(connection, std::move(answered));
+        return;
+    }
+    
+    // Whatever thread completes the request, the response is built and
+    // written back on the connection's own io thread. The responder shares
+    // ownership of that worker so its io_context is still there to post to
+    // however late the call comes; members go in reverse, so the connection
+    // (and its socket) is released before the worker can be.
+    struct Owner {
+        std::shared_ptr<Worker> worker;
+        std::shared_ptr<Connection> connection;
+    };
+    Owner owner{connection->worker_->shared_from_this(), connection};
+    Responder responder([this, owner, inFlight](std::string body, bool failed) {
+        // Once stop() has run the io thread is gone and nothing would
+        // answer the request, so the call is dropped
+        if (owner.worker->ioContext_.stopped()) {
+            return;
+        }
+        asio::post(owner.worker->ioContext_, [this, connection = owner.connection, inFlight, body = std::move(body), failed]() mutable {
+            (*inFlight)--;
+            HttpResponse response(&connection->arena_);
+            if (failed) {
+                Logger::error("Request handling error: " + body);
+                response = errorResponse(500, "Internal Server Error", "Internal server error");
+                connection->keepAlive_ = false;
+            } else {
+                try {
+                    response = renderResponse(*connection->request_, connection->cacheLookup_, std::move(body));
+                } catch (const std::exception& e) {
+                    Logger::error("Request handling error: " + std::string(e.what()));
+                    response = errorResponse(500, "Internal Server Error", "Internal server error");
+                    connection->keepAlive_ = false;
+                }
+            }
+            completeRequest(connection, std::move(response));
+        });
+    });
+    
+    if (route.asyncHandler) {
+        try {
+            route.asyncHandler(request, responder);
+        } catch (const std::exception& e) {
+            responder.fail(e.what());
+        }
+        return;
+    }
+    
+    asio::post(*m_handlerPool, [&route, &request, responder]() {
+        try {
+            responder.send(route.handler(request));
+        } catch (const std::exception& e) {
+            responder.fail(e.what());
+        }
+    });
+}
+
+void HttpServer::completeRequest(std::shared_ptr<Connection> connection, HttpResponse&& response) {
+    // The request views are done with; keep only what follows the request
+    connection->buffer_.erase(0, connection->bodyOffset_);
+    connection->buffer_.append(connection->leftover_);
+    connection->leftover_.clear();
+    resetRequest(*connection);
+    
+    writeResponse(connection, std::move(response));
+}
+
+void HttpServer::failRequest(std::shared_ptr<Connection> connection, int status, const std::string& statusText) {
+    // Whatever is left of the request can't be trusted, so the connection ends
+    connection->keepAlive_ = false;
+    rejectRequest(connection, errorResponse(status, statusText, statusText));
+}
+
+void HttpServer::rejectRequest(std::shared_ptr<Connection> connection, HttpResponse&& response) {
+    // Answer without running the handler. A connection that stays open keeps
+    // whatever follows the request head; otherwise the rest is dropped.
+    if (connection->keepAlive_) {
+        connection->buffer_.erase(0, connection->bodyOffset_);
+    } else {
+        connection->buffer_.clear();
+    }
+    resetRequest(*connection);
+    
+    writeResponse(connection, std::move(response));
+}
+
+bool HttpServer::allowRequest(uint64_t client, size_t routeId, double& retryAfter) {
+    const RouteOptions& options = m_routes[routeId].options;
+    double rate = options.rateLimit > 0 ? options.rateLimit : m_options.rateLimit;
+    if (rate <= 0) {
+        return true;
+    }
+    
+    double burst = options.rateLimit > 0 ? options.rateBurst : m_options.rateBurst;
+    return m_rateLimiter.tryAcquire(rateLimitKey(client, routeId), rate,
+                                    burst > 0 ? burst : rate, retryAfter);
+}
+
+void HttpServer::resetRequest(Connection& connection) {
+    connection.request_.reset();
+    connection.stream_.reset();
+    connection.parser_.reset();
+    connection.bodyParser_.reset();
+    connection.bodyOffset_ = 0;
+    connection.body_.clear();
+    if (connection.body_.capacity() > kRetainedBodyCapacity) {
+        connection.body_.shrink_to_fit();
+    }
+}
+
+HttpServer::HttpResponse HttpServer::handleRequest(HttpRequest& request, const Router::Match& match, BodyStream* stream,
+                                                   CacheLookup& lookup) {
+    if (match.status == Router::MatchStatus::NotFound) {
+        return errorResponse(404, "Not Found", "Endpoint not found");
+    }
+    if (match.status == Router::MatchStatus::MethodNotAllowed) {
+        return errorResponse(405, "Method Not Allowed", "Method not allowed");
+    }
+    
+    const Route& route = m_routes[match.routeId];
+    HttpResponse response(request.arena);
+    if (!validateRequest(request, match.routeId, response) || lookupCache(request, match.routeId, lookup, response)) {
+        return response;
+    }
+    
+    // Call handler; the returned body is moved, never copied
+    return renderResponse(request, lookup, stream ? stream->onComplete() : route.handler(request));
+}
+
+bool HttpServer::validateRequest(const HttpRequest& request, size_t routeId, HttpResponse& response) const {
+    const Route& route = m_routes[routeId];
+    std::string error;
+    if (!route.options.validate || route.options.validate(request, error)) {
+        return true;
+    }
+    response = errorResponse(400, "Bad Request", error);
+    return false;
+}
+
+bool HttpServer::lookupCache(const HttpRequest& request, size_t routeId, CacheLookup& lookup, HttpResponse& response) {
+    const Route& route = m_routes[routeId];
+    lookup.active = false;
+    if (!route.options.cacheVersion || request.method != "GET") {
+        return false;
+    }
+    
+    // Cached route: revalidate against the current data version and serve
+    // stored bytes while it has not moved
+    lookup.active = true;
+    lookup.version = route.options.cacheVersion();
+    ResponseCache::makeKey(routeId, request.params, lookup.key);
+    ResponseCache::makeETag(lookup.version, lookup.key, lookup.etag);
+    
+    // The 304 carries the validator of the copy the client holds, identity
+    // or compressed; Vary comes with the common headers when compression is on
+    std::string_view ifNoneMatch = request.header("If-None-Match");
+    if (!ifNoneMatch.empty()) {
+        ContentEncoding encoding = negotiateEncoding(request);
+        std::pmr::string matched(request.arena);
+        if (ResponseCache::matchesETag(ifNoneMatch, lookup.etag)) {
+            matched = lookup.etag;
+        } else if (encoding != ContentEncoding::Identity) {
+            std::pmr::string encoded = encodedETag(lookup.etag, encoding, request.arena);
+            if (ResponseCache::matchesETag(ifNoneMatch, encoded)) {
+                matched = std::move(encoded);
+            }
+        }
+        if (!matched.empty()) {
+            response.status_code = 304;
+            response.status_text = "Not Modified";
+            response.headers["ETag"] = std::move(matched);
+            response.headers["Cache-Control"] = "no-cache";
+            addCommonHeaders(response);
+            return true;
+        }
+    }
+    
+    auto entry = m_cache.find(lookup.key, lookup.version);
+    if (!entry) {
+        return false;
+    }
+    serveCacheEntry(request, *entry, lookup.etag, response);
+    return true;
+}
+
+HttpServer::HttpResponse HttpServer::renderResponse(const HttpRequest& request, const CacheLookup& lookup, std::string body) {
+    HttpResponse response(request.arena);
+    if (lookup.active) {
+        // Stored under the version read before the handler ran, so data that
+        // changed meanwhile is never cached as current
+        auto entry = m_cache.store(lookup.key, lookup.version, std::move(body));
+        serveCacheEntry(request, *entry, lookup.etag, response);
+        return response;
+    }
+    
+    response.body = std::move(body);
+    
+    ContentEncoding encoding = negotiateEncoding(request);
+    std::string compressed;
+    if (encoding != ContentEncoding::Identity && response.body.size() >= m_options.compressionMinSize &&
+        Compression::compress(response.body, encoding, m_options.compressionLevel, compressed) &&
+        compressed.size() < response.body.size()) {
+        response.body = std::move(compressed);
+        response.setHeader("Content-Encoding", Compression::name(encoding));
+    }
+    
+    addCommonHeaders(response);
+    return response;
+}
+
+void HttpServer::serveCacheEntry(const HttpRequest& request, const ResponseCache::Entry& entry, const std::string& etag,
+                                 HttpResponse& response) const {
+    response.sharedBody = entry.body;
+    response.headers["ETag"] = etag;
+    
+    // Compressed variants live with the entry, so each is built once
+    ContentEncoding encoding = negotiateEncoding(request);
+    if (encoding != ContentEncoding::Identity && entry.body->size() >= m_options.compressionMinSize) {
+        auto encoded = ResponseCache::encodedBody(entry, encoding, m_options.compressionLevel);
+        if (encoded != entry.body) {
+            response.sharedBody = encoded;
+            response.setHeader("Content-Encoding", Compression::name(encoding));
+            response.headers["ETag"] = encodedETag(etag, encoding, request.arena);
+        }
+    }
+    
+    response.headers["Cache-Control"] = "no-cache";
+    addCommonHeaders(response);
+}
+
+bool HttpServer::staticFileResponse(const HttpRequest& request, StaticFiles& files, HttpResponse& response) {
+    if (!request.params.has("path")) {
+        response.status_code = 301;
+        response.status_text = "Moved Permanently";
+        response.headers["Location"] = std::string(request.path) + "/";
+        return true;
+    }
+    
+    StaticFiles::Asset asset;
+    if (!files.findCached(request.params.get("path"), negotiateEncoding(request), asset)) {
+        return false;
+    }
+    response = assetResponse(request, asset);
+    return true;
+}
+
+void HttpServer::findStaticFile(std::shared_ptr<Connection> connection, std::atomic<size_t>* inFlight) {
+    const HttpRequest& request = *connection->request_;
+    StaticFiles& files = *m_routes[connection->match_.routeId].staticFiles;
+    
+    // Only browsers navigating to a client-side route get the index for a
+    // missing path; API clients and asset loads still see a 404
+    bool page = request.header("Accept").find("text/html") != std::string_view::npos;
+    
+    // The pool is joined in stop() before the workers are released, so the
+    // worker is still there to post back to, whether or not it still runs
+    Worker& worker = *connection->worker_;
+    asio::post(*m_handlerPool, [this, connection, inFlight, &files, &worker,
+                                path = std::string(request.params.get("path")),
+                                accepted = negotiateEncoding(request), page]() {
+        StaticFiles::Asset asset;
+        bool found = false;
+        bool failed = false;
+        try {
+            found = files.find(path, accepted, page, asset);
+        } catch (const std::exception& e) {
+            Logger::error("Static file error: " + std::string(e.what()));
+            failed = true;
+        }
+        
+        // The file is streamed for now; reading and compressing it for the
+        // cache happens behind this response
+        if (!asset.loadPath.empty()) {
+            asio::post(*m_handlerPool, [&files, loadPath = std::move(asset.loadPath)]() {
+                files.load(loadPath);
+            });
+        }
+        
+        asio::post(worker.ioContext_, [this, connection, inFlight, found, failed, asset = std::move(asset)]() mutable {
+            (*inFlight)--;
+            HttpResponse response(&connection->arena_);
+            if (failed) {
+                response = errorResponse(500, "Internal Server Error", "Internal server error");
+                connection->keepAlive_ = false;
+            } else if (!found) {
+                response = errorResponse(404, "Not Found", "File not found");
+            } else {
+                response = assetResponse(*connection->request_, asset);
+            }
+            completeRequest(connection, std::move(response));
+        });
+    });
+}
+
+HttpServer::HttpResponse HttpServer::assetResponse(const HttpRequest& request, StaticFiles::Asset& asset) {
+    HttpResponse response(request.arena);
+    if (ResponseCache::matchesETag(request.header("If-None-Match"), asset.etag)) {
+        response.status_code = 304;
+        response.status_text = "Not Modified";
+    } else {
+        response.sharedBody = std::move(asset.body);
+        response.file = std::move(asset.file);
+        response.headers["Content-Type"] = std::move(asset.contentType);
+        if (asset.encoding != ContentEncoding::Identity) {
+            response.setHeader("Content-Encoding", Compression::name(asset.encoding));
+        }
+    }
+    response.headers["ETag"] = std::move(asset.etag);
+    response.headers["Cache-Control"] = std::move(asset.cacheControl);
+    if (m_options.compression) {
+        response.headers["Vary"] = "Accept-Encoding";
+    }
+    return response;
+}
+
+ContentEncoding HttpServer::negotiateEncoding(const HttpRequest& request) const {
+    return m_options.compression
+        ? Compression::negotiate(request.header("Accept-Encoding"))
+        : ContentEncoding::Identity;
+}
+
+void HttpServer::addCommonHeaders(HttpResponse& response) const {
+    response.headerBlock = m_headerBlocks[m_corsEnabled ? 1 : 0];
+}
+
+HttpServer::HttpResponse HttpServer::webSocketHandshake(const HttpRequest& request, Connection& connection) {
+    if (!request.headerHasToken("Upgrade", "websocket") || !request.headerHasToken("Connection", "upgrade") ||
+        request.header("Sec-WebSocket-Version") != "13") {
+        HttpResponse response = errorResponse(426, "Upgrade Required", "WebSocket upgrade required");
+        response.headers["Upgrade"] = "websocket";
+        response.setHeader("Sec-WebSocket-Version", "13");
+        return response;
+    }
+    
+    std::string_view key = request.header("Sec-WebSocket-Key");
+    if (key.empty()) {
+        return errorResponse(400, "Bad Request", "Missing Sec-WebSocket-Key");
+    }
+    
+    HttpResponse response(request.arena);
+    response.status_code = 101;
+    response.status_text = "Switching Protocols";
+    response.headers["Upgrade"] = "websocket";
+    response.headers["Connection"] = "Upgrade";
+    response.setHeader("Sec-WebSocket-Accept", WebSocket::acceptKey(key));
+    connection.webSocket_ = true;
+    return response;
+}
+
+void HttpServer::readWebSocket(std::shared_ptr<Connection> connection) {
+    // Frames may already be buffered, e.g. sent right behind the handshake
+    std::string_view input(connection->buffer_);
+    size_t available = input.size();
+    WebSocket::Frame frame;
+    while (!connection->closing_) {
+        WebSocket::Result result = WebSocket::decodeFrame(input, frame, kMaxWebSocketPayload);
+        if (result == WebSocket::Result::Incomplete) {
+            break;
+        }
+        if (result == WebSocket::Result::Error) {
+            // Drop the rest of the queue so the close goes out promptly
+            connection->sendQueue_.clear();
+            pushFrame(connection, std::make_shared<const std::string>(
+                WebSocket::closeFrame(WebSocket::kCloseProtocolError)));
+            connection->closing_ = true;
+            return;
+        }
+        
+        if (frame.opcode == WebSocket::Opcode::Ping) {
+            pushFrame(connection, std::make_shared<const std::string>(
+                WebSocket::encodeFrame(WebSocket::Opcode::Pong, frame.payload)));
+        } else if (frame.opcode == WebSocket::Opcode::Close) {
+            // Echo the close and end the connection once it is written
+            pushFrame(connection, std::make_shared<const std::string>(
+                WebSocket::closeFrame(WebSocket::kCloseNormal)));
+            connection->closing_ = true;
+            return;
+        }
+        // The endpoint is push-only; data frames from clients are ignored
+    }
+    if (!connection->socket_.is_open()) {
+        return;
+    }
+    connection->buffer_.erase(0, available - input.size());
+    
+    size_t used = connection->buffer_.size();
+    connection->buffer_.resize(used + kReadChunkSize);
+    connection->asyncReadSome(asio::buffer(&connection->buffer_[used], kReadChunkSize),
+        [this, connection, used](std::error_code ec, std::size_t bytes_transferred) {
+            connection->buffer_.resize(used + bytes_transferred);
+            if (ec) {
+                closeSubscriber(connection);
+                return;
+            }
+            readWebSocket(connection);
+        });
+}
+
+HttpServer::HttpResponse HttpServer::eventStreamResponse(const HttpRequest& request, Connection& connection) {
+    // Resume after the client's last event, or start with the next one
+    std::string_view lastEventId = request.header("Last-Event-ID");
+    uint64_t id = 0;
+    auto [end, ec] = std::from_chars(lastEventId.data(), lastEventId.data() + lastEventId.size(), id);
+    if (lastEventId.empty() || ec != std::errc() || end != lastEventId.data() + lastEventId.size()) {
+        std::lock_guard<std::mutex> lock(m_eventMutex);
+        id = m_lastEventId;
+    }
+    
+    // The stream is delimited by closing the connection, so no Content-Length
+    HttpResponse response(request.arena);
+    response.body = kEventStreamPreamble;
+    response.headers["Content-Type"] = "text/event-stream";
+    response.headers["Cache-Control"] = "no-cache";
+    response.setHeader("X-Accel-Buffering", "no");
+    if (m_corsEnabled) {
+        response.setHeader("Access-Control-Allow-Origin", "*");
+    }
+    
+    connection.eventStream_ = true;
+    connection.lastEventId_ = id;
+    connection.keepAlive_ = false;
+    return response;
+}
+
+void HttpServer::startEventStream(std::shared_ptr<Connection> connection) {
+    connection->worker_->eventStreams_.push_back(connection);
+    m_eventStreamClients++;
+    
+    // Replay what the client missed; anything newer arrives through publishEvent
+    std::vector<std::shared_ptr<const std::string>> missed;
+    {
+        std::lock_guard<std::mutex> lock(m_eventMutex);
+        for (const auto& event : m_eventReplay) {
+            if (event.id > connection->lastEventId_) {
+                missed.push_back(event.frame);
+            }
+        }
+        connection->lastEventId_ = std::max(connection->lastEventId_, m_lastEventId);
+    }
+    for (auto& frame : missed) {
+        pushFrame(connection, std::move(frame));
+    }
+    
+    readEventStream(connection);
+}
+
+void HttpServer::readEventStream(std::shared_ptr<Connection> connection) {
+    // Nothing is expected from the client; the read only notices when it goes away
+    connection->buffer_.resize(kReadChunkSize);
+    connection->asyncReadSome(asio::buffer(connection->buffer_),
+        [this, connection](std::error_code ec, std::size_t) {
+            if (ec) {
+                closeSubscriber(connection);
+                return;
+            }
+            readEventStream(connection);
+        });
+}
+
+void HttpServer::scheduleHeartbeat(Worker& worker) {
+    // Comment lines keep idle streams from being cut by proxies
+    static const auto heartbeat = std::make_shared<const std::string>(": keep-alive\n\n");
+    
+    worker.heartbeatTimer_.expires_after(std::chrono::seconds(m_options.eventStreamHeartbeat));
+    worker.heartbeatTimer_.async_wait([this, &worker](std::error_code ec) {
+        if (ec || !m_running) return;
+        for (size_t i = worker.eventStreams_.size(); i-- > 0;) {
+            pushFrame(worker.eventStreams_[i], heartbeat);
+        }
+        scheduleHeartbeat(worker);
+    });
+}
+
+void HttpServer::pushFrame(std::shared_ptr<Connection> connection, std::shared_ptr<const std::string> frame) {
+    if (connection->closing_ || !connection->socket_.is_open()) {
+        return;
+    }
+    
+    // A client that can't keep up is cut off instead of buffering without bound
+    if (connection->sendQueue_.size() >= m_options.webSocketQueueLimit) {
+        Logger::warning("Dropping slow push client");
+        closeSubscriber(connection);
+        return;
+    }
+    
+    connection->sendQueue_.push_back(std::move(frame));
+    if (connection->sending_.empty()) {
+        flushFrames(connection);
+    }
+}
+
+void HttpServer::flushFrames(std::shared_ptr<Connection> connection) {
+    // Everything queued goes out in one gather write
+    connection->sendBuffers_.clear();
+    while (!connection->sendQueue_.empty()) {
+        connection->sending_.push_back(std::move(connection->sendQueue_.front()));
+        connection->sendQueue_.pop_front();
+        connection->sendBuffers_.push_back(asio::buffer(*connection->sending_.back()));
+    }
+    
+    connection->asyncWrite(connection->sendBuffers_,
+        [this, connection](std::error_code ec, std::size_t) {
+            connection->sending_.clear();
+            if (ec) {
+                closeSubscriber(connection);
+                return;
+            }
+            
+            if (!connection->sendQueue_.empty()) {
+                flushFrames(connection);
+            } else if (connection->closing_) {
+                closeSubscriber(connection);
+            }
+        });
+}
+
+void HttpServer::closeSubscriber(std::shared_ptr<Connection> connection) {
+    auto& clients = connection->webSocket_ ? connection->worker_->webSockets_ : connection->worker_->eventStreams_;
+    auto it = std::find(clients.begin(), clients.end(), connection);
+    if (it != clients.end()) {
+        *it = std::move(clients.back());
+        clients.pop_back();
+        (connection->webSocket_ ? m_webSocketClients : m_eventStreamClients)--;
+    }
+    
+    connection->sendQueue_.clear();
+    connection->close();
+}
+
+HttpServer::HttpResponse HttpServer::errorResponse(int status, const std::string& statusText, const std::string& message) const {
+    HttpResponse response;
+    response.status_code = status;
+    response.status_text = statusText;
+    // Messages may quote the request, so they are escaped for JSON
+    response.body = "{\"error\": \"";
+    for (char c : message) {
+        if (c == '"' || c == '\\') {
+            response.body.push_back('\\');
+            response.body.push_back(c);
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            response.body.append(escaped);
+        } else {
+            response.body.push_back(c);
+        }
+    }
+    response.body += "\"}";
+    response.headers["Content-Type"] = "application/json";
+    return response;
+}
+
+#ifdef HTTP_COROUTINES
+asio::awaitable<void> HttpServer::serveConnection(std::shared_ptr<Connection> connection) {
+    // Request parsing, routing and dispatch are shared with callback mode;
+    // only the socket I/O between them happens here. Frames come from asio's
+    // per-thread recycling allocator, so a keep-alive connection costs one
+    // frame for its whole life instead of a handler allocation per step.
+    auto& socket = connection->socket_;
+    asio::error_code ec;
+    auto token = asio::redirect_error(asio::use_awaitable, ec);
+    connection->coroutine_ = true;
+    
+    while (true) {
+        // Read until processRequest has a complete head to act on
+        while (connection->buffer_.empty() || !processRequest(connection)) {
+            armIdleTimer(connection);
+            size_t used = connection->buffer_.size();
+            connection->buffer_.resize(used + kReadChunkSize);
+            size_t bytes = co_await connection->asyncReadSome(asio::buffer(&connection->buffer_[used], kReadChunkSize), token);
+            connection->idleTimer_.cancel();
+            connection->buffer_.resize(used + bytes);
+            if (ec) {
+                connection->close();
+                co_return;
+            }
+            armDeadline(connection);
+        }
+        
+        // Follow the request through its body and dispatch until the response is out
+        while (true) {
+            while (connection->next_ == Connection::Step::None) {
+                co_await connection->wakeup_.async_wait(token);
+                if (!socket.is_open()) {
+                    co_return;
+                }
+            }
+            Connection::Step step = std::exchange(connection->next_, Connection::Step::None);
+            
+            if (step == Connection::Step::ReadBody) {
+                HttpBodyParser::Result result = HttpBodyParser::Result::Incomplete;
+                while (result == HttpBodyParser::Result::Incomplete) {
+                    armDeadline(connection);
+                    armIdleTimer(connection);
+                    connection->bodyChunk_.resize(kReadChunkSize);
+                    size_t bytes = co_await connection->asyncReadSome(asio::buffer(connection->bodyChunk_), token);
+                    connection->idleTimer_.cancel();
+                    if (ec) {
+                        connection->close();
+                        co_return;
+                    }
+                    
+                    std::string_view input(connection->bodyChunk_.data(), bytes);
+                    result = consumeBody(connection, input);
+                    if (result == HttpBodyParser::Result::Complete) {
+                        finishRequest(connection, input);
+                    }
+                }
+                continue;
+            }
+            
+            std::array<asio::const_buffer, 2> buffers = {
+                asio::buffer(connection->responseHead_),
+                asio::buffer(connection->response_.payload())
+            };
+            co_await connection->asyncWrite(buffers, token);
+            if (!ec && connection->response_.file) {
+                co_await connection->asyncSendFile(token);
+            }
+            cancelDeadline(*connection);
+            if (ec) {
+                Logger::error("Failed to send response: " + ec.message());
+                connection->close();
+                co_return;
+            }
+            break;
+        }
+        
+        if (!afterResponse(connection)) {
+            co_return;
+        }
+    }
+}
+#endif
+
+void HttpServer::writeResponse(std::shared_ptr<Connection> connection, HttpResponse&& response) {
+    int64_t contentLength = -1;
+    if (response.status_code != 304 && response.status_code != 101 && !connection->eventStream_) {
+        contentLength = static_cast<int64_t>(response.file ? response.file->size() : response.payload().length());
+    }
+    // A 101 carries its own "Connection: Upgrade"
+    std::string_view connectionHeaders;
+    if (!connection->webSocket_) {
+        connectionHeaders = connection->keepAlive_ ? std::string_view(m_keepAliveHeaders) : "Connection: close\r\n";
+    }
+    
+    // The request is in; from here the deadline covers the write
+    cancelDeadline(*connection);
+    armDeadline(connection);
+    
+    connection->response_ = std::move(response);
+    connection->responseHead_ = connection->response_.head(dateHeader(), connectionHeaders, contentLength);
+    connection->fileOffset_ = 0;
+    
+#ifdef HTTP_COROUTINES
+    // The connection's coroutine does the write and carries on from there
+    if (connection->coroutine_) {
+        connection->resume(Connection::Step::Write);
+        return;
+    }
+#endif
+    
+    // Header block and body go out in one gather write without joining them.
+    // The next request is only read once this one is written, which keeps
+    // pipelined responses in request order.
+    std::array<asio::const_buffer, 2> buffers = {
+        asio::buffer(connection->responseHead_),
+        asio::buffer(connection->response_.payload())
+    };
+    auto written = [this, connection](std::error_code ec, std::size_t = 0) {
+        cancelDeadline(*connection);
+        if (ec) {
+            Logger::error("Failed to send response: " + ec.message());
+            connection->close();
+            return;
+        }
+        
+        if (afterResponse(connection)) {
+            readRequest(connection);
+        }
+    };
+    if (!connection->response_.file) {
+        connection->write(buffers, std::move(written));
+        return;
+    }
+    
+    // Files follow their head once it is out
+    connection->write(buffers,
+        [connection, written = std::move(written)](std::error_code ec, std::size_t) mutable {
+            if (ec) {
+                written(ec);
+                return;
+            }
+            connection->asyncSendFile(connection->withMemory(std::move(written)));
+        });
+}
+
+bool HttpServer::afterResponse(std::shared_ptr<Connection> connection) {
+    if (connection->webSocket_) {
+        // Handshake is out: the connection now receives broadcasts
+        connection->worker_->webSockets_.push_back(connection);
+        m_webSocketClients++;
+        readWebSocket(connection);
+    } else if (connection->eventStream_) {
+        startEventStream(connection);
+    } else if (connection->keepAlive_) {
+        connection->resetArena();
+        return true;
+    } else {
+        connection->close();
+    }
+    return false;
+}
+
+// HttpRequest implementation
+HttpServer::HttpRequest::HttpRequest(const HttpParser& parser, std::pmr::memory_resource* arena)
+    : method(parser.method())
+    , path(parser.path())
+    , query(parser.query())
+    , version(parser.version())
+    , arena(arena)
+    , m_head(parser) {
+}
+
+bool HttpServer::HttpRequest::wantsKeepAlive() const {
+    if (version == "HTTP/1.1") {
+        return !m_head.headerHasToken("Connection", "close");
+    }
+    return m_head.headerHasToken("Connection", "keep-alive");
+}
+
+// HttpResponse implementation
+std::pmr::string HttpServer::HttpResponse::head(std::string_view date, std::string_view connection,
+                                                int64_t contentLength) const {
+    char code[12];
+    std::string_view codeText(code, std::to_chars(code, code + sizeof(code), status_code).ptr - code);
+    char length[20];
+    std::string_view lengthText;
+    if (contentLength >= 0) {
+        lengthText = std::string_view(length, std::to_chars(length, length + sizeof(length), contentLength).ptr - length);
+    }
+    
+    size_t size = 9 + codeText.size() + 1 + status_text.size() + 2 + date.size() + headerBlock.size() +
+                  connection.size() + 2;
+    for (const auto& header : headers) {
+        size += header.first.size() + 2 + header.second.size() + 2;
+    }
+    if (contentLength >= 0) {
+        size += 16 + lengthText.size() + 2;
+    }
+    
+    std::pmr::string out(headers.get_allocator());
+    out.reserve(size);
+    
+    // Status line
+    out.append("HTTP/1.1 ").append(codeText).append(" ").append(status_text).append("\r\n");
+    
+    // Preformatted lines, then the response's own headers
+    out.append(date).append(headerBlock);
+    for (const auto& header : headers) {
+        out.append(header.first).append(": ").append(header.second).append("\r\n");
+    }
+    if (contentLength >= 0) {
+        out.append("Content-Length: ").append(lengthText).append("\r\n");
+    }
+    out.append(connection);
+    
+    // Empty line
+    out.append("\r\n");
     
-    return oss.str();
-} 
\ No newline at end of file
+    return out;
+}
\ No newline at end of file
@@ -0,0 +1,574 @@
+#include "network/IoUring.h"
+
+#ifdef HAS_IO_URING
+
+#include "utils/Logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint16_t kBufferGroup = 0;
+constexpr unsigned kProbeOps = 256;
+constexpr size_t kMaxFreeOperations = 1024;
+
+int ioUringSetup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+int ioUringRegister(int fd, unsigned opcode, void* arg, unsigned count) {
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+// Ring indices are shared with the kernel, so each side publishes with
+// release and reads the other side's with acquire
+unsigned loadAcquire(const unsigned* index) {
+    return __atomic_load_n(index, __ATOMIC_ACQUIRE);
+}
+
+void storeRelease(unsigned* index, unsigned value) {
+    __atomic_store_n(index, value, __ATOMIC_RELEASE);
+}
+
+asio::error_code errorFor(int result) {
+    return asio::error_code(-result, asio::error::get_system_category());
+}
+
+}
+
+struct IoUring::Operation {
+    enum class Kind {
+        Accept,
+        Read,
+        Write
+    };
+
+    Kind kind;
+    int fd = -1;
+    AcceptHandler onAccept{};
+    IoHandler onIo{};
+
+    // Read target; selectBuffer lets the kernel pick a registered buffer
+    asio::mutable_buffer target{};
+    bool selectBuffer = false;
+
+    // Write state, which must stay put until the kernel is done with it
+    std::vector<iovec> vectors{};
+    size_t nextVector = 0;
+    msghdr message{};
+    size_t transferred = 0;
+
+    Operation* prev = nullptr;
+    Operation* next = nullptr;
+};
+
+IoUring::IoUring(asio::io_context& ioContext, HandlerMemory& handlerMemory)
+    : m_ioContext(ioContext)
+    , m_handlerMemory(handlerMemory)
+    , m_watch(ioContext) {
+}
+
+IoUring::~IoUring() {
+    close();
+}
+
+bool IoUring::open(unsigned entries, unsigned bufferCount, size_t bufferSize, std::string& error) {
+    io_uring_params params{};
+    int fd = ioUringSetup(entries, &params);
+    if (fd < 0) {
+        error = std::string("io_uring_setup: ") + std::strerror(errno);
+        return false;
+    }
+    m_ringFd = fd;
+
+    // NODROP keeps completions that overflow the CQ ring instead of losing them
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP)) {
+        error = "kernel io_uring is too old";
+        close();
+        return false;
+    }
+
+    // Multishot accept and buffer rings came in 5.19 along with
+    // IORING_OP_SOCKET, which unlike them shows up in the probe
+    std::vector<char> probeStorage(sizeof(io_uring_probe) + kProbeOps * sizeof(io_uring_probe_op), 0);
+    auto* probe = reinterpret_cast<io_uring_probe*>(probeStorage.data());
+    if (ioUringRegister(fd, IORING_REGISTER_PROBE, probe, kProbeOps) < 0) {
+        error = std::string("io_uring probe: ") + std::strerror(errno);
+        close();
+        return false;
+    }
+    for (unsigned op : {IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SENDMSG, IORING_OP_ASYNC_CANCEL, IORING_OP_SOCKET}) {
+        if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+            error = "kernel io_uring lacks operation " + std::to_string(op);
+            close();
+            return false;
+        }
+    }
+
+    m_ringSize = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                          params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+    void* ring = ::mmap(nullptr, m_ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring == MAP_FAILED) {
+        error = std::string("io_uring mmap: ") + std::strerror(errno);
+        close();
+        return false;
+    }
+    m_ring = ring;
+
+    m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        error = std::string("io_uring mmap: ") + std::strerror(errno);
+        close();
+        return false;
+    }
+    m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+    char* base = static_cast<char*>(m_ring);
+    m_sqHead = reinterpret_cast<unsigned*>(base + params.sq_off.head);
+    m_sqTailPtr = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+    m_sqFlags = reinterpret_cast<unsigned*>(base + params.sq_off.flags);
+    m_sqMask = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+    m_sqEntries = params.sq_entries;
+    m_sqTail = *m_sqTailPtr;
+    m_cqHead = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+    m_cqTail = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+    m_cqMask = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+    m_cqes = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+
+    // SQEs are always filled in ring order, so the index array is fixed
+    auto* array = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+    for (unsigned i = 0; i < m_sqEntries; ++i) {
+        array[i] = i;
+    }
+
+    // Without registered buffers receives go straight into the caller's memory
+    if (bufferCount > 0 && (bufferCount & (bufferCount - 1)) == 0 && bufferCount <= 32768) {
+        size_t ringBytes = bufferCount * sizeof(io_uring_buf);
+        void* bufferRing = ::mmap(nullptr, ringBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        io_uring_buf_reg registration{};
+        registration.ring_addr = reinterpret_cast<uint64_t>(bufferRing);
+        registration.ring_entries = bufferCount;
+        registration.bgid = kBufferGroup;
+        if (bufferRing != MAP_FAILED && ioUringRegister(fd, IORING_REGISTER_PBUF_RING, &registration, 1) == 0) {
+            m_bufferRing = static_cast<io_uring_buf_ring*>(bufferRing);
+            m_bufferRingSize = ringBytes;
+            m_bufferMemory = std::make_unique<char[]>(bufferCount * bufferSize);
+            m_bufferCount = bufferCount;
+            m_bufferSize = bufferSize;
+            for (unsigned i = 0; i < bufferCount; ++i) {
+                recycleBuffer(static_cast<uint16_t>(i));
+            }
+        } else {
+            Logger::warning("io_uring buffer ring unavailable, receiving without registered buffers");
+            if (bufferRing != MAP_FAILED) {
+                ::munmap(bufferRing, ringBytes);
+            }
+        }
+    }
+
+    m_watch.assign(fd);
+    watch();
+    return true;
+}
+
+void IoUring::acceptMultishot(int listenFd, AcceptHandler handler) {
+    auto* operation = new Operation{Operation::Kind::Accept};
+    operation->fd = listenFd;
+    operation->onAccept = std::move(handler);
+    m_accept = operation;
+    link(operation);
+    start(operation);
+}
+
+void IoUring::cancelAccept() {
+    if (!m_accept) return;
+
+    io_uring_sqe* sqe = nextSqe();
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(m_accept);
+    push();
+}
+
+void IoUring::readSome(int fd, asio::mutable_buffer buffer, IoHandler handler) {
+    Operation* operation = acquire();
+    operation->kind = Operation::Kind::Read;
+    operation->fd = fd;
+    operation->onIo = std::move(handler);
+    operation->target = buffer;
+    operation->selectBuffer = m_bufferRing != nullptr && buffer.size() <= m_bufferSize;
+    link(operation);
+    start(operation);
+}
+
+void IoUring::write(int fd, const asio::const_buffer* buffers, size_t count, IoHandler handler) {
+    Operation* operation = acquire();
+    operation->kind = Operation::Kind::Write;
+    operation->fd = fd;
+    operation->onIo = std::move(handler);
+    for (size_t i = 0; i < count; ++i) {
+        if (buffers[i].size() > 0) {
+            operation->vectors.push_back({const_cast<void*>(buffers[i].data()), buffers[i].size()});
+        }
+    }
+
+    link(operation);
+    if (operation->vectors.empty()) {
+        asio::post(m_ioContext, [this, operation]() {
+            IoHandler handler = std::move(operation->onIo);
+            release(operation);
+            handler(std::error_code(), 0);
+        });
+        return;
+    }
+    start(operation);
+}
+
+void IoUring::submit() {
+    m_submitPosted = false;
+    while (m_queued > 0) {
+        int submitted = ioUringEnter(m_ringFd, m_queued, 0, 0);
+        if (submitted < 0) {
+            if (errno == EINTR) continue;
+
+            // The kernel is holding overflowed completions; retry once they are reaped
+            if (errno == EBUSY || errno == EAGAIN) {
+                m_submitPosted = true;
+                asio::post(m_ioContext, [this]() {
+                    reap();
+                    submit();
+                });
+                return;
+            }
+            Logger::error("io_uring_enter failed: " + std::string(std::strerror(errno)));
+            return;
+        }
+        m_queued -= static_cast<unsigned>(submitted);
+    }
+}
+
+IoUring::Operation* IoUring::acquire() {
+    if (!m_free) {
+        return new Operation{Operation::Kind::Read};
+    }
+    Operation* operation = m_free;
+    m_free = operation->next;
+    m_freeCount--;
+    operation->next = nullptr;
+    return operation;
+}
+
+io_uring_sqe* IoUring::nextSqe() {
+    if (m_sqTail - loadAcquire(m_sqHead) >= m_sqEntries) {
+        submit();
+        if (m_sqTail - loadAcquire(m_sqHead) >= m_sqEntries) {
+            return nullptr;
+        }
+    }
+
+    io_uring_sqe* sqe = &m_sqes[m_sqTail & m_sqMask];
+    std::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+void IoUring::push() {
+    storeRelease(m_sqTailPtr, ++m_sqTail);
+    m_queued++;
+
+    // Everything queued while completions are handled goes in with one
+    // io_uring_enter at the end of reap(); otherwise at the end of this turn
+    if (!m_reaping && !m_submitPosted) {
+        m_submitPosted = true;
+        asio::post(m_ioContext, bindHandlerMemory(m_handlerMemory, [this]() {
+            submit();
+        }));
+    }
+}
+
+void IoUring::start(Operation* operation) {
+    io_uring_sqe* sqe = nextSqe();
+    if (!sqe) {
+        asio::post(m_ioContext, [this, operation]() {
+            complete(operation, -EBUSY, 0);
+        });
+        return;
+    }
+
+    sqe->fd = operation->fd;
+    sqe->user_data = reinterpret_cast<uint64_t>(operation);
+    switch (operation->kind) {
+        case Operation::Kind::Accept:
+            sqe->opcode = IORING_OP_ACCEPT;
+            sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+            sqe->accept_flags = SOCK_CLOEXEC;
+            break;
+        case Operation::Kind::Read:
+            sqe->opcode = IORING_OP_RECV;
+            sqe->len = static_cast<uint32_t>(operation->target.size());
+            if (operation->selectBuffer) {
+                sqe->flags = IOSQE_BUFFER_SELECT;
+                sqe->buf_group = kBufferGroup;
+            } else {
+                sqe->addr = reinterpret_cast<uint64_t>(operation->target.data());
+            }
+            break;
+        case Operation::Kind::Write:
+            operation->message.msg_iov = &operation->vectors[operation->nextVector];
+            operation->message.msg_iovlen = operation->vectors.size() - operation->nextVector;
+            sqe->opcode = IORING_OP_SENDMSG;
+            sqe->addr = reinterpret_cast<uint64_t>(&operation->message);
+            sqe->len = 1;
+            sqe->msg_flags = MSG_NOSIGNAL;
+            break;
+    }
+    push();
+}
+
+void IoUring::watch() {
+    m_watch.async_wait(asio::posix::stream_descriptor::wait_read, bindHandlerMemory(m_handlerMemory, [this](std::error_code ec) {
+        if (!ec) {
+            reap();
+            watch();
+        }
+    }));
+
+    // The io_context watches fds edge-triggered, so completions that came in
+    // after the last reap but before this wait would not wake it
+    if (loadAcquire(m_cqTail) != *m_cqHead) {
+        asio::post(m_ioContext, bindHandlerMemory(m_handlerMemory, [this]() {
+            reap();
+        }));
+    }
+}
+
+void IoUring::reap() {
+    m_reaping = true;
+    while (true) {
+        unsigned head = *m_cqHead;
+        unsigned tail = loadAcquire(m_cqTail);
+        if (head == tail) {
+            // Completions that overflowed the CQ ring wait in the kernel until asked for
+            if ((__atomic_load_n(m_sqFlags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW) &&
+                ioUringEnter(m_ringFd, 0, 0, IORING_ENTER_GETEVENTS) >= 0 && loadAcquire(m_cqTail) != head) {
+                continue;
+            }
+            break;
+        }
+
+        for (; head != tail; ++head) {
+            const io_uring_cqe& cqe = m_cqes[head & m_cqMask];
+            auto* operation = reinterpret_cast<Operation*>(cqe.user_data);
+            int result = cqe.res;
+            uint32_t flags = cqe.flags;
+            storeRelease(m_cqHead, head + 1);
+
+            // Cancel requests carry no operation
+            if (operation) {
+                complete(operation, result, flags);
+            }
+        }
+    }
+    m_reaping = false;
+
+    if (m_queued > 0) {
+        submit();
+    }
+}
+
+void IoUring::complete(Operation* operation, int result, uint32_t flags) {
+    if (operation->kind == Operation::Kind::Read && (flags & IORING_CQE_F_BUFFER)) {
+        uint16_t id = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+        if (result > 0 && !m_closing) {
+            std::memcpy(operation->target.data(), m_bufferMemory.get() + id * m_bufferSize, static_cast<size_t>(result));
+        }
+        recycleBuffer(id);
+    }
+
+    // While the ring is being torn down nothing is handed back
+    if (m_closing) {
+        if (!(flags & IORING_CQE_F_MORE)) {
+            release(operation);
+        }
+        return;
+    }
+
+    switch (operation->kind) {
+        case Operation::Kind::Accept: {
+            bool more = (flags & IORING_CQE_F_MORE) != 0;
+            asio::error_code ec = result < 0 ? errorFor(result) : asio::error_code();
+            if (more) {
+                operation->onAccept(ec, result, true);
+                return;
+            }
+
+            AcceptHandler handler = std::move(operation->onAccept);
+            if (m_accept == operation) {
+                m_accept = nullptr;
+            }
+            release(operation);
+            handler(ec, result, false);
+            return;
+        }
+        case Operation::Kind::Read: {
+            if (result == -ENOBUFS && operation->selectBuffer) {
+                // Every registered buffer is in use; read into the caller's memory
+                operation->selectBuffer = false;
+                start(operation);
+                return;
+            }
+
+            asio::error_code ec;
+            if (result < 0) {
+                ec = errorFor(result);
+            } else if (result == 0) {
+                ec = asio::error::eof;
+            }
+            IoHandler handler = std::move(operation->onIo);
+            release(operation);
+            handler(ec, result > 0 ? static_cast<size_t>(result) : 0);
+            return;
+        }
+        case Operation::Kind::Write: {
+            if (result > 0) {
+                // Skip what went out and send the rest
+                operation->transferred += static_cast<size_t>(result);
+                size_t sent = static_cast<size_t>(result);
+                auto& vectors = operation->vectors;
+                while (operation->nextVector < vectors.size() && sent >= vectors[operation->nextVector].iov_len) {
+                    sent -= vectors[operation->nextVector++].iov_len;
+                }
+                if (operation->nextVector < vectors.size()) {
+                    auto& partial = vectors[operation->nextVector];
+                    partial.iov_base = static_cast<char*>(partial.iov_base) + sent;
+                    partial.iov_len -= sent;
+                    start(operation);
+                    return;
+                }
+            }
+
+            asio::error_code ec;
+            if (result < 0) {
+                ec = errorFor(result);
+            } else if (result == 0) {
+                ec = asio::error::broken_pipe;
+            }
+            IoHandler handler = std::move(operation->onIo);
+            size_t transferred = operation->transferred;
+            release(operation);
+            handler(ec, transferred);
+            return;
+        }
+    }
+}
+
+void IoUring::recycleBuffer(uint16_t id) {
+    // Entries start at the top of the ring; the header's flexible array
+    // member picks up padding when compiled as C++, so it can't be used
+    auto* entries = reinterpret_cast<io_uring_buf*>(m_bufferRing);
+    io_uring_buf& buffer = entries[m_bufferTail & (m_bufferCount - 1)];
+    buffer.addr = reinterpret_cast<uint64_t>(m_bufferMemory.get() + id * m_bufferSize);
+    buffer.len = static_cast<uint32_t>(m_bufferSize);
+    buffer.bid = id;
+    __atomic_store_n(&m_bufferRing->tail, ++m_bufferTail, __ATOMIC_RELEASE);
+}
+
+void IoUring::link(Operation* operation) {
+    operation->next = m_outstanding;
+    if (m_outstanding) {
+        m_outstanding->prev = operation;
+    }
+    m_outstanding = operation;
+}
+
+void IoUring::release(Operation* operation) {
+    if (operation->prev) {
+        operation->prev->next = operation->next;
+    } else {
+        m_outstanding = operation->next;
+    }
+    if (operation->next) {
+        operation->next->prev = operation->prev;
+    }
+
+    // Reads and writes are recycled, keeping their iovec capacity
+    if (operation->kind == Operation::Kind::Accept || m_freeCount >= kMaxFreeOperations) {
+        delete operation;
+        return;
+    }
+    operation->fd = -1;
+    operation->onIo.reset();
+    operation->target = asio::mutable_buffer();
+    operation->selectBuffer = false;
+    operation->vectors.clear();
+    operation->nextVector = 0;
+    operation->message = msghdr{};
+    operation->transferred = 0;
+    operation->prev = nullptr;
+    operation->next = m_free;
+    m_free = operation;
+    m_freeCount++;
+}
+
+void IoUring::close() {
+    // Requests still in the kernel may write into memory their operations
+    // own, so cancel them all and wait for the last completion first
+    if (m_sqes && m_outstanding) {
+        m_closing = true;
+        if (io_uring_sqe* sqe = nextSqe()) {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = -1;
+            sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+            push();
+        }
+        submit();
+        while (m_outstanding) {
+            if (ioUringEnter(m_ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+                break;
+            }
+            reap();
+        }
+    }
+
+    if (m_watch.is_open()) {
+        m_watch.release();
+    }
+    if (m_bufferRing) {
+        ::munmap(m_bufferRing, m_bufferRingSize);
+        m_bufferRing = nullptr;
+    }
+    if (m_sqes) {
+        ::munmap(m_sqes, m_sqesSize);
+        m_sqes = nullptr;
+    }
+    if (m_ring) {
+        ::munmap(m_ring, m_ringSize);
+        m_ring = nullptr;
+    }
+    if (m_ringFd >= 0) {
+        ::close(m_ringFd);
+        m_ringFd = -1;
+    }
+
+    while (m_outstanding) {
+        release(m_outstanding);
+    }
+    while (m_free) {
+        delete std::exchange(m_free, m_free->next);
+    }
+    m_freeCount = 0;
+}
+
+#endif
@@ -0,0 +1,113 @@
+#include "network/RateLimiter.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr uint64_t kMilli = 1000;   // tokens are stored in thousandths
+
+uint64_t mix(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    return key;
+}
+
+uint32_t stateTime(uint64_t state) { return static_cast<uint32_t>(state >> 32); }
+uint64_t stateTokens(uint64_t state) { return state & 0xffffffffull; }
+uint64_t makeState(uint32_t time, uint64_t tokens) { return (uint64_t(time) << 32) | tokens; }
+
+// Milliseconds from then to now. Another thread may have stored a time
+// later than the now read here; that counts as no time passed rather than
+// wrapping around to ~49 days.
+uint32_t elapsedMs(uint32_t now, uint32_t then) {
+    int32_t elapsed = static_cast<int32_t>(now - then);
+    return elapsed > 0 ? static_cast<uint32_t>(elapsed) : 0;
+}
+
+}
+
+RateLimiter::RateLimiter(size_t capacity)
+    : m_shardSize(std::max<size_t>(kProbeLimit, capacity / kShardCount))
+    , m_epoch(std::chrono::steady_clock::now()) {
+    m_slots.reset(new Slot[m_shardSize * kShardCount]);
+}
+
+uint32_t RateLimiter::nowMs() const {
+    // Offset by one so a stored time is never 0; wraps after ~49 days, which
+    // the differences taken in elapsedMs tolerate
+    auto elapsed = std::chrono::steady_clock::now() - m_epoch;
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()) + 1;
+}
+
+RateLimiter::Slot& RateLimiter::slotFor(uint64_t key, uint32_t now) {
+    uint64_t hash = mix(key);
+    Slot* shard = &m_slots[(hash % kShardCount) * m_shardSize];
+    size_t start = static_cast<size_t>(hash >> 32) % m_shardSize;
+
+    Slot* oldest = nullptr;
+    uint32_t oldestAge = 0;
+    for (size_t i = 0; i < kProbeLimit; ++i) {
+        Slot& slot = shard[(start + i) % m_shardSize];
+        uint64_t current = slot.key.load(std::memory_order_acquire);
+        if (current == key) {
+            return slot;
+        }
+        if (current == 0) {
+            if (slot.key.compare_exchange_strong(current, key, std::memory_order_acq_rel)) {
+                return slot;
+            }
+            if (current == key) {
+                return slot;
+            }
+        }
+
+        uint32_t age = elapsedMs(now, stateTime(slot.state.load(std::memory_order_relaxed)));
+        if (!oldest || age > oldestAge) {
+            oldest = &slot;
+            oldestAge = age;
+        }
+    }
+
+    // Window full: recycle the least recently used bucket. Losing the race
+    // just means sharing a bucket for a moment, which is harmless here.
+    uint64_t previous = oldest->key.load(std::memory_order_relaxed);
+    if (oldest->key.compare_exchange_strong(previous, key, std::memory_order_acq_rel)) {
+        oldest->state.store(0, std::memory_order_relaxed);
+    }
+    return *oldest;
+}
+
+bool RateLimiter::tryAcquire(uint64_t key, double rate, double burst, double& retryAfter) {
+    // 0 marks an empty slot
+    key = key ? key : 1;
+
+    uint32_t now = nowMs();
+    Slot& slot = slotFor(key, now);
+
+    uint64_t capacity = static_cast<uint64_t>(std::max(burst, 1.0) * kMilli);
+    double perMs = rate;    // thousandths of a token per millisecond
+    uint64_t state = slot.state.load(std::memory_order_relaxed);
+    while (true) {
+        uint64_t tokens = capacity;
+        uint32_t time = now;
+        if (state != 0) {
+            uint32_t elapsed = elapsedMs(now, stateTime(state));
+            tokens = std::min<uint64_t>(capacity, stateTokens(state) + static_cast<uint64_t>(elapsed * perMs));
+            // Never move the bucket's clock backwards, or the next refill
+            // would count the same milliseconds twice
+            if (elapsed == 0) {
+                time = stateTime(state);
+            }
+        }
+
+        if (tokens < kMilli) {
+            retryAfter = (kMilli - tokens) / (perMs * 1000.0);
+            return false;
+        }
+
+        if (slot.state.compare_exchange_weak(state, makeState(time, tokens - kMilli), std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
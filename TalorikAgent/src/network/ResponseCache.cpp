@@ -0,0 +1,149 @@
+#include "network/ResponseCache.h"
+#include <algorithm>
+#include <charconv>
+#include <functional>
+#include <mutex>
+
+namespace {
+
+uint64_t fnv1a(std::string_view data) {
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : data) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+void appendHex(std::string& out, uint64_t value) {
+    static const char digits[] = "0123456789abcdef";
+    char buffer[16];
+    int length = 0;
+    do {
+        buffer[length++] = digits[value & 0xf];
+        value >>= 4;
+    } while (value != 0);
+    while (length > 0) {
+        out.push_back(buffer[--length]);
+    }
+}
+
+}
+
+ResponseCache::ResponseCache(size_t maxEntries)
+    : m_maxEntriesPerShard(std::max<size_t>(1, maxEntries / kShardCount)) {
+}
+
+ResponseCache::Shard& ResponseCache::shardFor(const std::string& key) const {
+    return m_shards[std::hash<std::string>()(key) % kShardCount];
+}
+
+std::shared_ptr<const ResponseCache::Entry> ResponseCache::find(const std::string& key, uint64_t version) const {
+    Shard& shard = shardFor(key);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+
+    auto it = shard.entries.find(key);
+    if (it == shard.entries.end() || it->second->version != version) {
+        return nullptr;
+    }
+    return it->second;
+}
+
+std::shared_ptr<const ResponseCache::Entry> ResponseCache::store(const std::string& key, uint64_t version, std::string body) {
+    auto entry = std::make_shared<Entry>();
+    entry->version = version;
+    entry->body = std::make_shared<const std::string>(std::move(body));
+
+    Shard& shard = shardFor(key);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+
+    // Parameters come from clients, so bound the shard: drop outdated
+    // entries first and start over if it is still full
+    if (shard.entries.size() >= m_maxEntriesPerShard && shard.entries.find(key) == shard.entries.end()) {
+        for (auto it = shard.entries.begin(); it != shard.entries.end();) {
+            it = it->second->version != version ? shard.entries.erase(it) : std::next(it);
+        }
+        if (shard.entries.size() >= m_maxEntriesPerShard) {
+            shard.entries.clear();
+        }
+    }
+
+    shard.entries[key] = entry;
+    return entry;
+}
+
+void ResponseCache::clear() {
+    for (auto& shard : m_shards) {
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        shard.entries.clear();
+    }
+}
+
+std::shared_ptr<const std::string> ResponseCache::encodedBody(const Entry& entry, ContentEncoding encoding, int level) {
+    if (encoding == ContentEncoding::Identity) {
+        return entry.body;
+    }
+
+    auto& slot = encoding == ContentEncoding::Gzip ? entry.gzipBody : entry.deflateBody;
+    auto body = std::atomic_load(&slot);
+    if (body) {
+        return body;
+    }
+
+    // Two threads may race to fill the slot; both results are equivalent
+    std::string compressed;
+    if (Compression::compress(*entry.body, encoding, level, compressed) && compressed.size() < entry.body->size()) {
+        body = std::make_shared<const std::string>(std::move(compressed));
+    } else {
+        body = entry.body;
+    }
+    std::atomic_store(&slot, body);
+    return body;
+}
+
+void ResponseCache::makeKey(size_t routeId, const RouteParams& params, std::string& key) {
+    std::array<std::pair<std::string_view, std::string_view>, RouteParams::kMaxParams> sorted;
+    size_t count = params.size();
+    for (size_t i = 0; i < count; ++i) {
+        sorted[i] = params[i];
+    }
+    std::sort(sorted.begin(), sorted.begin() + count);
+
+    char digits[20];
+    key.assign(digits, std::to_chars(digits, digits + sizeof(digits), routeId).ptr);
+    for (size_t i = 0; i < count; ++i) {
+        key.push_back(i == 0 ? '?' : '&');
+        key.append(sorted[i].first).push_back('=');
+        key.append(sorted[i].second);
+    }
+}
+
+void ResponseCache::makeETag(uint64_t version, const std::string& key, std::string& etag) {
+    etag.clear();
+    etag.reserve(36);
+    etag.push_back('"');
+    appendHex(etag, version);
+    etag.push_back('-');
+    appendHex(etag, fnv1a(key));
+    etag.push_back('"');
+}
+
+bool ResponseCache::matchesETag(std::string_view ifNoneMatch, std::string_view etag) {
+    while (!ifNoneMatch.empty()) {
+        size_t comma = ifNoneMatch.find(',');
+        std::string_view candidate = ifNoneMatch.substr(0, comma);
+
+        while (!candidate.empty() && candidate.front() == ' ') candidate.remove_prefix(1);
+        while (!candidate.empty() && candidate.back() == ' ') candidate.remove_suffix(1);
+        // If-None-Match uses weak comparison
+        if (candidate.substr(0, 2) == "W/") candidate.remove_prefix(2);
+
+        if (candidate == "*" || candidate == etag) {
+            return true;
+        }
+
+        if (comma == std::string_view::npos) break;
+        ifNoneMatch.remove_prefix(comma + 1);
+    }
+    return false;
+}
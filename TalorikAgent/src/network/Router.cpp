@@ -0,0 +1,292 @@
+#include "network/Router.h"
+#include <stdexcept>
+#include <charconv>
+
+namespace {
+    int hexValue(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+}
+
+// RouteParams implementation
+RouteParams::RouteParams(const RouteParams& other)
+    : m_items(other.m_items)
+    , m_count(other.m_count)
+    , m_decoded(other.m_decoded) {
+    rebase(other.m_decoded.data(), m_decoded.data(), m_decoded.size());
+}
+
+RouteParams& RouteParams::operator=(const RouteParams& other) {
+    if (this != &other) {
+        m_items = other.m_items;
+        m_count = other.m_count;
+        m_decoded = other.m_decoded;
+        rebase(other.m_decoded.data(), m_decoded.data(), m_decoded.size());
+    }
+    return *this;
+}
+
+void RouteParams::rebase(const char* from, const char* to, size_t size) {
+    // Point views that were into another decode buffer at the same bytes in ours
+    auto move = [&](std::string_view& view) {
+        if (size > 0 && view.data() >= from && view.data() < from + size) {
+            view = std::string_view(to + (view.data() - from), view.size());
+        }
+    };
+    for (size_t i = 0; i < m_count; ++i) {
+        move(m_items[i].first);
+        move(m_items[i].second);
+    }
+}
+
+std::string_view RouteParams::get(std::string_view name, std::string_view defaultValue) const {
+    for (size_t i = 0; i < m_count; ++i) {
+        if (m_items[i].first == name) {
+            return m_items[i].second;
+        }
+    }
+    return defaultValue;
+}
+
+bool RouteParams::has(std::string_view name) const {
+    for (size_t i = 0; i < m_count; ++i) {
+        if (m_items[i].first == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int RouteParams::getInt(std::string_view name, int defaultValue) const {
+    std::string_view value = get(name);
+    int result = 0;
+    auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+    if (value.empty() || ec != std::errc() || end != value.data() + value.size()) {
+        return defaultValue;
+    }
+    return result;
+}
+
+void RouteParams::add(std::string_view name, std::string_view value) {
+    if (m_count < kMaxParams) {
+        m_items[m_count++] = {name, value};
+    }
+}
+
+void RouteParams::parseQuery(std::string_view query) {
+    // Decoding never makes text longer, so this is all the room it needs
+    if (query.find_first_of("%+") != std::string_view::npos) {
+        const char* before = m_decoded.data();
+        m_decoded.reserve(m_decoded.size() + query.size());
+        rebase(before, m_decoded.data(), m_decoded.size());
+    }
+
+    while (!query.empty()) {
+        size_t amp = query.find('&');
+        std::string_view pair = query.substr(0, amp);
+
+        size_t equalPos = pair.find('=');
+        if (equalPos != std::string_view::npos && equalPos > 0) {
+            std::string_view key = decoded(pair.substr(0, equalPos));
+            if (!has(key)) {
+                add(key, decoded(pair.substr(equalPos + 1)));
+            }
+        }
+
+        if (amp == std::string_view::npos) break;
+        query.remove_prefix(amp + 1);
+    }
+}
+
+std::string_view RouteParams::decoded(std::string_view text) {
+    if (text.find_first_of("%+") == std::string_view::npos) {
+        return text;
+    }
+    size_t start = m_decoded.size();
+    decode(text, m_decoded);
+    return std::string_view(m_decoded.data() + start, m_decoded.size() - start);
+}
+
+void RouteParams::decode(std::string_view text, std::string& out) {
+    for (size_t i = 0; i < text.size(); ++i) {
+        char c = text[i];
+        if (c == '+') {
+            c = ' ';
+        } else if (c == '%' && i + 2 < text.size() && hexValue(text[i + 1]) >= 0 && hexValue(text[i + 2]) >= 0) {
+            c = static_cast<char>(hexValue(text[i + 1]) * 16 + hexValue(text[i + 2]));
+            i += 2;
+        }
+        out.push_back(c);
+    }
+}
+
+// Router implementation
+struct Router::Node {
+    std::string prefix;                                 // compressed static edge
+    std::vector<std::unique_ptr<Node>> children;        // static children, distinct first chars
+    std::unique_ptr<Node> paramChild;                   // "{name}" segment
+    std::unique_ptr<Node> catchAllChild;                // "{name*}" final segment
+    std::string paramName;                              // set on param and catch-all nodes
+    std::vector<std::pair<std::string, size_t>> routes; // method -> route id
+};
+
+Router::Router() : m_root(std::make_unique<Node>()) {
+}
+
+Router::~Router() = default;
+
+void Router::add(const std::string& method, const std::string& pathTemplate, size_t routeId) {
+    if (pathTemplate.empty() || pathTemplate[0] != '/') {
+        throw std::invalid_argument("Route must start with '/': " + pathTemplate);
+    }
+
+    Node* node = m_root.get();
+    std::string_view rest = pathTemplate;
+    while (!rest.empty()) {
+        size_t open = rest.find('{');
+        node = insertStatic(node, rest.substr(0, open));
+        if (open == std::string_view::npos) break;
+
+        // A parameter must span a whole segment
+        size_t close = rest.find('}', open);
+        if (open == 0 || rest[open - 1] != '/' || close == std::string_view::npos ||
+            close == open + 1 || (close + 1 < rest.size() && rest[close + 1] != '/')) {
+            throw std::invalid_argument("Malformed route parameter in " + pathTemplate);
+        }
+
+        std::string name(rest.substr(open + 1, close - open - 1));
+        if (name.back() == '*') {
+            // Catch-all: the rest of the path, so it has to come last
+            name.pop_back();
+            if (name.empty() || close + 1 != rest.size()) {
+                throw std::invalid_argument("Malformed route parameter in " + pathTemplate);
+            }
+            if (!node->catchAllChild) {
+                node->catchAllChild = std::make_unique<Node>();
+                node->catchAllChild->paramName = name;
+            } else if (node->catchAllChild->paramName != name) {
+                throw std::invalid_argument("Conflicting parameter name {" + name + "*} in " + pathTemplate);
+            }
+            node = node->catchAllChild.get();
+            break;
+        }
+        
+        if (!node->paramChild) {
+            node->paramChild = std::make_unique<Node>();
+            node->paramChild->paramName = name;
+        } else if (node->paramChild->paramName != name) {
+            throw std::invalid_argument("Conflicting parameter name {" + name + "} in " + pathTemplate);
+        }
+        node = node->paramChild.get();
+        rest = rest.substr(close + 1);
+    }
+
+    for (auto& route : node->routes) {
+        if (route.first == method) {
+            route.second = routeId;
+            return;
+        }
+    }
+    node->routes.emplace_back(method, routeId);
+}
+
+Router::Node* Router::insertStatic(Node* node, std::string_view text) {
+    while (!text.empty()) {
+        Node* next = nullptr;
+        for (auto& child : node->children) {
+            if (child->prefix[0] == text[0]) {
+                next = child.get();
+
+                size_t common = 0;
+                while (common < child->prefix.size() && common < text.size() &&
+                       child->prefix[common] == text[common]) {
+                    ++common;
+                }
+
+                // Split the edge where the new path diverges
+                if (common < child->prefix.size()) {
+                    auto split = std::make_unique<Node>();
+                    split->prefix = child->prefix.substr(0, common);
+                    child->prefix.erase(0, common);
+                    split->children.push_back(std::move(child));
+                    child = std::move(split);
+                    next = child.get();
+                }
+
+                text.remove_prefix(common);
+                break;
+            }
+        }
+
+        if (!next) {
+            auto leaf = std::make_unique<Node>();
+            leaf->prefix = std::string(text);
+            next = leaf.get();
+            node->children.push_back(std::move(leaf));
+            text = std::string_view();
+        }
+        node = next;
+    }
+    return node;
+}
+
+Router::Match Router::match(std::string_view method, std::string_view path, RouteParams& params) const {
+    const Node* node = matchNode(m_root.get(), path, params);
+    if (!node) {
+        return {MatchStatus::NotFound, 0};
+    }
+
+    for (const auto& route : node->routes) {
+        if (route.first == method) {
+            return {MatchStatus::Found, route.second};
+        }
+    }
+    return {MatchStatus::MethodNotAllowed, 0};
+}
+
+const Router::Node* Router::matchNode(const Node* node, std::string_view path, RouteParams& params) const {
+    if (path.empty()) {
+        if (!node->routes.empty()) {
+            return node;
+        }
+        // A catch-all also matches nothing at all, e.g. "/" for "/{path*}"
+        return matchCatchAll(node, path, params);
+    }
+
+    // Static edges take precedence over parameters
+    for (const auto& child : node->children) {
+        if (child->prefix[0] == path[0]) {
+            if (path.compare(0, child->prefix.size(), child->prefix) == 0) {
+                if (const Node* found = matchNode(child.get(), path.substr(child->prefix.size()), params)) {
+                    return found;
+                }
+            }
+            break;
+        }
+    }
+
+    if (node->paramChild) {
+        std::string_view value = path.substr(0, path.find('/'));
+        if (!value.empty()) {
+            size_t mark = params.size();
+            params.add(node->paramChild->paramName, value);
+            if (const Node* found = matchNode(node->paramChild.get(), path.substr(value.size()), params)) {
+                return found;
+            }
+            params.truncate(mark);
+        }
+    }
+
+    return matchCatchAll(node, path, params);
+}
+
+const Router::Node* Router::matchCatchAll(const Node* node, std::string_view path, RouteParams& params) const {
+    if (!node->catchAllChild || node->catchAllChild->routes.empty()) {
+        return nullptr;
+    }
+    params.add(node->catchAllChild->paramName, path);
+    return node->catchAllChild.get();
+}
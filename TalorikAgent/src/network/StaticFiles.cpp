@@ -0,0 +1,525 @@
+#include "network/StaticFiles.h"
+#include "utils/Logger.h"
+#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+#include <mutex>
+#include <array>
+#include <stdexcept>
+#include <charconv>
+#include <chrono>
+
+#if defined(__linux__) && defined(ASIO_HAS_POSIX_STREAM_DESCRIPTOR)
+#define STATIC_FILES_INOTIFY
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr size_t kMinCompressSize = 256;        // smaller files gain nothing from a coding
+    constexpr auto kRecheckInterval = std::chrono::seconds(1);
+
+    int64_t steadyNow() {
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+    }
+
+    void appendHex(std::string& out, uint64_t value) {
+        static const char digits[] = "0123456789abcdef";
+        char buffer[16];
+        int length = 0;
+        do {
+            buffer[length++] = digits[value & 0xf];
+            value >>= 4;
+        } while (value != 0);
+        while (length > 0) {
+            out.push_back(buffer[--length]);
+        }
+    }
+}
+
+struct StaticFiles::Entry {
+    std::string contentType;
+    std::string etag;
+    std::shared_ptr<const std::string> body;
+    std::shared_ptr<const std::string> gzipBody;        // null when compressing did not help
+    std::shared_ptr<const std::string> deflateBody;
+    std::filesystem::path path;
+    std::filesystem::file_time_type writeTime;
+    uint64_t size = 0;
+    size_t footprint = 0;                               // bytes counted against maxCacheSize
+    mutable std::atomic<int64_t> checkedAt{0};          // last modification time check, without inotify
+};
+
+#ifdef STATIC_FILES_INOTIFY
+// Watches the directory tree and drops cache entries for changed files
+class StaticFiles::Watcher {
+public:
+    Watcher(StaticFiles& files, asio::io_context& ioContext, int fd)
+        : files_(files), descriptor_(ioContext, fd) {}
+
+    // Watch a directory and everything below it
+    bool addDirectory(const std::filesystem::path& path, const std::string& prefix) {
+        int wd = inotify_add_watch(descriptor_.native_handle(), path.c_str(),
+                                   IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE |
+                                   IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR);
+        if (wd < 0) {
+            Logger::warning("Cannot watch " + path.string() + ": " + std::error_code(errno, std::system_category()).message());
+            return false;
+        }
+        directories_[wd] = prefix;
+
+        std::error_code ec;
+        for (const auto& child : std::filesystem::directory_iterator(path, ec)) {
+            if (child.is_directory(ec) && !addDirectory(child.path(), prefix + child.path().filename().string() + "/")) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void read() {
+        descriptor_.async_read_some(asio::buffer(buffer_), [this](asio::error_code ec, size_t bytes) {
+            if (ec) {
+                if (ec != asio::error::operation_aborted) {
+                    Logger::warning("Stopped watching " + files_.m_directory + ": " + ec.message());
+                    files_.m_watching = false;
+                    files_.clear();
+                }
+                return;
+            }
+
+            for (size_t offset = 0; offset + sizeof(inotify_event) <= bytes;) {
+                const auto* event = reinterpret_cast<const inotify_event*>(buffer_.data() + offset);
+                offset += sizeof(inotify_event) + event->len;
+                handle(*event);
+            }
+            read();
+        });
+    }
+
+private:
+    StaticFiles& files_;
+    asio::posix::stream_descriptor descriptor_;
+    std::unordered_map<int, std::string> directories_;  // watch descriptor -> "" or "dir/"
+    alignas(inotify_event) std::array<char, 16 * 1024> buffer_;
+
+    void handle(const inotify_event& event) {
+        if (event.mask & IN_Q_OVERFLOW) {
+            files_.clear();
+            return;
+        }
+        if (event.mask & IN_IGNORED) {
+            directories_.erase(event.wd);
+            return;
+        }
+
+        auto directory = directories_.find(event.wd);
+        if (directory == directories_.end() || event.len == 0) {
+            return;
+        }
+        std::string relativePath = directory->second + event.name;
+
+        if (event.mask & IN_ISDIR) {
+            // A whole subtree appeared or went away; new ones are watched too
+            if (event.mask & (IN_CREATE | IN_MOVED_TO)) {
+                addDirectory(files_.m_root / relativePath, relativePath + "/");
+            }
+            files_.clear();
+        } else {
+            files_.invalidate(relativePath);
+        }
+    }
+};
+#else
+class StaticFiles::Watcher {
+};
+#endif
+
+// StaticFiles implementation
+StaticFiles::StaticFiles(const std::string& directory, const Options& options)
+    : m_directory(directory)
+    , m_root(directory)
+    , m_options(options)
+    , m_watching(false) {
+    std::error_code ec;
+    if (!std::filesystem::is_directory(m_root, ec)) {
+        throw std::invalid_argument("Static file directory not found: " + directory);
+    }
+}
+
+StaticFiles::~StaticFiles() = default;
+
+bool StaticFiles::findCached(std::string_view path, ContentEncoding accepted, Asset& asset) {
+    std::string relativePath;
+    if (!normalize(path, relativePath)) {
+        return false;
+    }
+    if (relativePath.empty()) {
+        relativePath = m_options.indexFile;
+    }
+
+    std::shared_ptr<const Entry> entry = cached(relativePath);
+    if (!entry) {
+        return false;
+    }
+    if (!isCurrent(*entry)) {
+        invalidate(relativePath);
+        return false;
+    }
+    fill(*entry, accepted, asset);
+    return true;
+}
+
+bool StaticFiles::find(std::string_view path, ContentEncoding accepted, bool page, Asset& asset) {
+    std::string relativePath;
+    if (!normalize(path, relativePath)) {
+        return false;
+    }
+    if (relativePath.empty()) {
+        relativePath = m_options.indexFile;
+    }
+
+    std::shared_ptr<const Entry> entry = cached(relativePath);
+    if (entry) {
+        if (isCurrent(*entry)) {
+            fill(*entry, accepted, asset);
+            return true;
+        }
+        invalidate(relativePath);
+    }
+
+    std::error_code ec;
+    std::filesystem::path filePath = m_root / relativePath;
+    if (std::filesystem::is_directory(filePath, ec)) {
+        return find(relativePath + "/" + m_options.indexFile, accepted, page, asset);
+    }
+    if (!std::filesystem::is_regular_file(filePath, ec)) {
+        // Client-side routes such as "/alerts/42" render the index page
+        size_t slash = relativePath.rfind('/');
+        bool extension = relativePath.find('.', slash == std::string::npos ? 0 : slash) != std::string::npos;
+        if (!m_options.indexFallback || !page || extension || relativePath == m_options.indexFile) {
+            return false;
+        }
+        return find(std::string_view(), accepted, page, asset);
+    }
+
+    uint64_t size = std::filesystem::file_size(filePath, ec);
+    if (ec) {
+        return false;
+    }
+
+    // Streamed from disk: too large for the cache, the cache is full, or
+    // the file is being read into it
+    auto file = std::make_shared<OpenFile>(filePath);
+    if (!file->isOpen()) {
+        return false;
+    }
+    asset.contentType = contentType(relativePath);
+    asset.etag = makeETag(file->size(), std::filesystem::last_write_time(filePath, ec));
+    asset.cacheControl = cacheControl(asset.contentType);
+    asset.encoding = ContentEncoding::Identity;
+    asset.body.reset();
+    asset.file = std::move(file);
+    asset.loadPath.clear();
+    if (size <= m_options.maxCachedFileSize && startLoad(relativePath)) {
+        asset.loadPath = relativePath;
+    }
+    return true;
+}
+
+void StaticFiles::load(const std::string& relativePath) {
+    store(relativePath, m_root / relativePath);
+
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    m_loading.erase(relativePath);
+}
+
+std::shared_ptr<const StaticFiles::Entry> StaticFiles::cached(const std::string& relativePath) const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    auto it = m_entries.find(relativePath);
+    return it != m_entries.end() ? it->second : nullptr;
+}
+
+// Claims the load of a file, so concurrent misses on it read it only once
+bool StaticFiles::startLoad(const std::string& relativePath) {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    if (m_cacheSize >= m_options.maxCacheSize) {
+        return false;
+    }
+    return m_loading.insert(relativePath).second;
+}
+
+void StaticFiles::store(const std::string& relativePath, const std::filesystem::path& path) {
+    uint64_t generation;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        if (m_cacheSize >= m_options.maxCacheSize) {
+            return;
+        }
+        generation = m_generation;
+    }
+
+    auto entry = std::make_shared<Entry>();
+    entry->path = path;
+    std::error_code ec;
+    entry->writeTime = std::filesystem::last_write_time(path, ec);
+    std::ifstream in(path, std::ios::binary);
+    if (ec || !in) {
+        return;
+    }
+    std::string body((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (in.bad() || body.size() > m_options.maxCachedFileSize) {
+        return;
+    }
+
+    entry->size = body.size();
+    entry->contentType = contentType(relativePath);
+    entry->etag = makeETag(entry->size, entry->writeTime);
+    entry->checkedAt = steadyNow();
+
+    // Compressed once here rather than per response, at the best ratio
+    if (compressible(entry->contentType) && body.size() >= kMinCompressSize) {
+        std::string compressed;
+        if (Compression::compress(body, ContentEncoding::Gzip, m_options.compressionLevel, compressed) &&
+            compressed.size() < body.size()) {
+            entry->gzipBody = std::make_shared<const std::string>(std::move(compressed));
+        }
+        compressed.clear();
+        if (Compression::compress(body, ContentEncoding::Deflate, m_options.compressionLevel, compressed) &&
+            compressed.size() < body.size()) {
+            entry->deflateBody = std::make_shared<const std::string>(std::move(compressed));
+        }
+    }
+    entry->footprint = body.size() + (entry->gzipBody ? entry->gzipBody->size() : 0) +
+                       (entry->deflateBody ? entry->deflateBody->size() : 0);
+    entry->body = std::make_shared<const std::string>(std::move(body));
+
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    if (generation != m_generation) {
+        // Changed while being read; the next miss tries again
+        return;
+    }
+    auto it = m_entries.find(relativePath);
+    size_t replaced = it != m_entries.end() ? it->second->footprint : 0;
+    if (m_cacheSize - replaced + entry->footprint > m_options.maxCacheSize) {
+        return;
+    }
+    m_cacheSize = m_cacheSize - replaced + entry->footprint;
+    m_entries[relativePath] = entry;
+}
+
+bool StaticFiles::isCurrent(const Entry& entry) const {
+    if (m_watching) {
+        return true;
+    }
+
+    // Without inotify the file is looked at again once the interval is up
+    int64_t now = steadyNow();
+    int64_t checkedAt = entry.checkedAt;
+    if (now - checkedAt < std::chrono::duration_cast<std::chrono::steady_clock::duration>(kRecheckInterval).count() ||
+        !entry.checkedAt.compare_exchange_strong(checkedAt, now)) {
+        return true;
+    }
+
+    std::error_code ec;
+    auto writeTime = std::filesystem::last_write_time(entry.path, ec);
+    if (ec || writeTime != entry.writeTime) {
+        return false;
+    }
+    uint64_t size = std::filesystem::file_size(entry.path, ec);
+    return !ec && size == entry.size;
+}
+
+void StaticFiles::invalidate(const std::string& relativePath) {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    ++m_generation;
+    auto it = m_entries.find(relativePath);
+    if (it != m_entries.end()) {
+        m_cacheSize -= it->second->footprint;
+        m_entries.erase(it);
+    }
+}
+
+void StaticFiles::clear() {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    ++m_generation;
+    m_entries.clear();
+    m_cacheSize = 0;
+}
+
+void StaticFiles::fill(const Entry& entry, ContentEncoding accepted, Asset& asset) const {
+    asset.contentType = entry.contentType;
+    asset.cacheControl = cacheControl(entry.contentType);
+    asset.file.reset();
+    asset.loadPath.clear();
+
+    const auto& encoded = accepted == ContentEncoding::Gzip ? entry.gzipBody
+                        : accepted == ContentEncoding::Deflate ? entry.deflateBody
+                        : entry.body;
+    if (encoded && encoded != entry.body) {
+        // Each coding is its own representation and needs its own validator
+        asset.body = encoded;
+        asset.encoding = accepted;
+        asset.etag = entry.etag.substr(0, entry.etag.size() - 1) + "-" + Compression::name(accepted) + "\"";
+    } else {
+        asset.body = entry.body;
+        asset.encoding = ContentEncoding::Identity;
+        asset.etag = entry.etag;
+    }
+}
+
+std::string StaticFiles::cacheControl(std::string_view contentType) const {
+    // Pages are revalidated so a new build shows up at once; the assets they
+    // reference may be kept for maxAge
+    if (m_options.maxAge <= 0 || contentType.substr(0, 9) == "text/html") {
+        return "no-cache";
+    }
+    return "public, max-age=" + std::to_string(m_options.maxAge);
+}
+
+void StaticFiles::watch(asio::io_context& ioContext) {
+#ifdef STATIC_FILES_INOTIFY
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        Logger::warning("inotify unavailable, checking " + m_directory + " for changes once a second");
+        return;
+    }
+
+    m_watcher = std::make_unique<Watcher>(*this, ioContext, fd);
+    if (!m_watcher->addDirectory(m_root, std::string())) {
+        Logger::warning("Checking " + m_directory + " for changes once a second instead");
+        m_watcher.reset();
+        return;
+    }
+
+    // Entries cached before the watch started may already be stale
+    clear();
+    m_watching = true;
+    m_watcher->read();
+#else
+    (void)ioContext;
+    Logger::info("Checking " + m_directory + " for changes once a second");
+#endif
+}
+
+void StaticFiles::unwatch() {
+    m_watching = false;
+    m_watcher.reset();
+}
+
+bool StaticFiles::normalize(std::string_view path, std::string& relativePath) {
+    std::string decoded;
+    decoded.reserve(path.size());
+    for (size_t i = 0; i < path.size(); ++i) {
+        char c = path[i];
+        if (c == '%') {
+            unsigned value = 0;
+            if (i + 2 >= path.size() ||
+                std::from_chars(path.data() + i + 1, path.data() + i + 3, value, 16).ptr != path.data() + i + 3) {
+                return false;
+            }
+            c = static_cast<char>(value);
+            i += 2;
+        }
+        // Backslashes and drive letters are separators on Windows
+        if (c == '\0' || c == '\\' || c == ':') {
+            return false;
+        }
+        decoded.push_back(c);
+    }
+
+    relativePath.clear();
+    size_t start = 0;
+    while (start < decoded.size()) {
+        size_t end = decoded.find('/', start);
+        if (end == std::string::npos) {
+            end = decoded.size();
+        }
+        std::string_view segment(decoded.data() + start, end - start);
+        if (!segment.empty() && segment != ".") {
+            if (segment[0] == '.') {
+                return false;
+            }
+            if (!relativePath.empty()) {
+                relativePath.push_back('/');
+            }
+            relativePath.append(segment);
+        }
+        start = end + 1;
+    }
+    return true;
+}
+
+const char* StaticFiles::contentType(std::string_view relativePath) {
+    static const std::pair<const char*, const char*> types[] = {
+        {"html", "text/html; charset=utf-8"},
+        {"htm", "text/html; charset=utf-8"},
+        {"css", "text/css; charset=utf-8"},
+        {"js", "text/javascript; charset=utf-8"},
+        {"mjs", "text/javascript; charset=utf-8"},
+        {"json", "application/json"},
+        {"map", "application/json"},
+        {"webmanifest", "application/manifest+json"},
+        {"txt", "text/plain; charset=utf-8"},
+        {"xml", "application/xml"},
+        {"svg", "image/svg+xml"},
+        {"png", "image/png"},
+        {"jpg", "image/jpeg"},
+        {"jpeg", "image/jpeg"},
+        {"gif", "image/gif"},
+        {"webp", "image/webp"},
+        {"avif", "image/avif"},
+        {"ico", "image/x-icon"},
+        {"woff", "font/woff"},
+        {"woff2", "font/woff2"},
+        {"ttf", "font/ttf"},
+        {"otf", "font/otf"},
+        {"wasm", "application/wasm"},
+        {"pdf", "application/pdf"},
+    };
+
+    size_t dot = relativePath.rfind('.');
+    size_t slash = relativePath.rfind('/');
+    if (dot != std::string_view::npos && (slash == std::string_view::npos || dot > slash)) {
+        std::string_view extension = relativePath.substr(dot + 1);
+        for (const auto& type : types) {
+            if (extension.size() == std::char_traits<char>::length(type.first) &&
+                std::equal(extension.begin(), extension.end(), type.first,
+                           [](char a, char b) { return std::tolower(static_cast<unsigned char>(a)) == b; })) {
+                return type.second;
+            }
+        }
+    }
+    return "application/octet-stream";
+}
+
+bool StaticFiles::compressible(std::string_view contentType) {
+    return contentType.substr(0, 5) == "text/" || contentType.substr(0, 16) == "application/json" ||
+           contentType == "application/manifest+json" || contentType == "application/xml" ||
+           contentType == "image/svg+xml" || contentType == "application/wasm" ||
+           contentType == "font/ttf" || contentType == "font/otf" || contentType == "image/x-icon";
+}
+
+std::string StaticFiles::makeETag(uint64_t size, std::filesystem::file_time_type writeTime) {
+    // Size and modification time, as most servers do
+    std::string etag = "\"";
+    appendHex(etag, size);
+    etag.push_back('-');
+    appendHex(etag, static_cast<uint64_t>(writeTime.time_since_epoch().count()));
+    etag.push_back('"');
+    return etag;
+}
+
+// OpenFile implementation
+StaticFiles::OpenFile::OpenFile(const std::filesystem::path& path)
+    : m_file(std::fopen(path.string().c_str(), "rb"))
+    , m_size(0) {
+    std::error_code ec;
+    if (m_file) {
+        m_size = std::filesystem::file_size(path, ec);
+    }
+    if (ec) {
+        m_file.reset();
+    }
+}
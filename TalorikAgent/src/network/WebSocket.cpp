@@ -0,0 +1,183 @@
+#include "network/WebSocket.h"
+#include <array>
+
+namespace {
+
+constexpr char kHandshakeGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+uint32_t rotateLeft(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+// SHA-1 is only used for the handshake, so a small local version avoids
+// pulling in a crypto library
+std::array<uint8_t, 20> sha1(std::string_view data) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+    std::string message(data);
+    uint64_t bitLength = static_cast<uint64_t>(data.size()) * 8;
+    message.push_back(static_cast<char>(0x80));
+    while (message.size() % 64 != 56) {
+        message.push_back(0);
+    }
+    for (int i = 7; i >= 0; --i) {
+        message.push_back(static_cast<char>((bitLength >> (i * 8)) & 0xff));
+    }
+
+    for (size_t block = 0; block < message.size(); block += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i) {
+            const auto* p = reinterpret_cast<const uint8_t*>(&message[block + i * 4]);
+            w[i] = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+        }
+        for (int i = 16; i < 80; ++i) {
+            w[i] = rotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t temp = rotateLeft(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotateLeft(b, 30);
+            b = a;
+            a = temp;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    std::array<uint8_t, 20> digest;
+    for (int i = 0; i < 20; ++i) {
+        digest[i] = static_cast<uint8_t>(h[i / 4] >> (24 - (i % 4) * 8));
+    }
+    return digest;
+}
+
+std::string base64(const uint8_t* data, size_t size) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    out.reserve((size + 2) / 3 * 4);
+    for (size_t i = 0; i < size; i += 3) {
+        uint32_t chunk = uint32_t(data[i]) << 16;
+        if (i + 1 < size) chunk |= uint32_t(data[i + 1]) << 8;
+        if (i + 2 < size) chunk |= uint32_t(data[i + 2]);
+
+        out.push_back(alphabet[(chunk >> 18) & 0x3f]);
+        out.push_back(alphabet[(chunk >> 12) & 0x3f]);
+        out.push_back(i + 1 < size ? alphabet[(chunk >> 6) & 0x3f] : '=');
+        out.push_back(i + 2 < size ? alphabet[chunk & 0x3f] : '=');
+    }
+    return out;
+}
+
+}
+
+std::string WebSocket::acceptKey(std::string_view key) {
+    std::string input(key);
+    input.append(kHandshakeGuid);
+    auto digest = sha1(input);
+    return base64(digest.data(), digest.size());
+}
+
+std::string WebSocket::encodeFrame(Opcode opcode, std::string_view payload) {
+    std::string frame;
+    frame.reserve(payload.size() + 10);
+    frame.push_back(static_cast<char>(0x80 | static_cast<uint8_t>(opcode)));
+
+    uint64_t length = payload.size();
+    if (length < 126) {
+        frame.push_back(static_cast<char>(length));
+    } else if (length <= 0xffff) {
+        frame.push_back(static_cast<char>(126));
+        frame.push_back(static_cast<char>(length >> 8));
+        frame.push_back(static_cast<char>(length & 0xff));
+    } else {
+        frame.push_back(static_cast<char>(127));
+        for (int i = 7; i >= 0; --i) {
+            frame.push_back(static_cast<char>((length >> (i * 8)) & 0xff));
+        }
+    }
+
+    frame.append(payload.data(), payload.size());
+    return frame;
+}
+
+std::string WebSocket::closeFrame(uint16_t code) {
+    char payload[2] = {static_cast<char>(code >> 8), static_cast<char>(code & 0xff)};
+    return encodeFrame(Opcode::Close, std::string_view(payload, sizeof(payload)));
+}
+
+WebSocket::Result WebSocket::decodeFrame(std::string_view& input, Frame& frame, uint64_t maxPayload) {
+    if (input.size() < 2) {
+        return Result::Incomplete;
+    }
+
+    const auto* bytes = reinterpret_cast<const uint8_t*>(input.data());
+    bool fin = (bytes[0] & 0x80) != 0;
+    uint8_t opcode = bytes[0] & 0x0f;
+    bool masked = (bytes[1] & 0x80) != 0;
+    uint64_t length = bytes[1] & 0x7f;
+
+    // No extensions are negotiated, so reserved bits must be clear
+    if ((bytes[0] & 0x70) != 0 || !masked) {
+        return Result::Error;
+    }
+
+    bool control = (opcode & 0x08) != 0;
+    if ((opcode > 0x2 && opcode < 0x8) || opcode > 0xA || (control && (!fin || length > 125))) {
+        return Result::Error;
+    }
+
+    size_t offset = 2;
+    if (length == 126 || length == 127) {
+        size_t extra = length == 126 ? 2 : 8;
+        if (input.size() < offset + extra) {
+            return Result::Incomplete;
+        }
+        length = 0;
+        for (size_t i = 0; i < extra; ++i) {
+            length = (length << 8) | bytes[offset + i];
+        }
+        offset += extra;
+    }
+
+    // Refuse oversized frames before buffering them
+    if (length > maxPayload) {
+        return Result::Error;
+    }
+
+    if (input.size() < offset + 4 + length) {
+        return Result::Incomplete;
+    }
+
+    const uint8_t* mask = bytes + offset;
+    offset += 4;
+
+    frame.fin = fin;
+    frame.opcode = static_cast<Opcode>(opcode);
+    frame.payload.assign(input.data() + offset, static_cast<size_t>(length));
+    for (size_t i = 0; i < frame.payload.size(); ++i) {
+        frame.payload[i] = static_cast<char>(frame.payload[i] ^ mask[i % 4]);
+    }
+
+    input.remove_prefix(offset + static_cast<size_t>(length));
+    return Result::Complete;
+}
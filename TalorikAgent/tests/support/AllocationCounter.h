@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// Heap allocation counter for tests and benchmarks.
+//
+// Replaces every global operator new and delete, aligned and array forms
+// included, and counts each allocation made while counting is on by a
+// thread that has not opted out (e.g. a benchmark's own client threads).
+// Replacement allocation functions may only be defined once per program,
+// so include this header from exactly one source file of each executable.
+struct AllocationCounter {
+    static inline std::atomic<uint64_t> allocations{0};
+    static inline std::atomic<bool> counting{true};
+    static inline thread_local bool ignoreThread = false;
+
+    // The allocation and release paths stay out of line: inlined into a
+    // caller, free() on memory from operator new trips -Wmismatched-new-delete
+    [[gnu::noinline]] static void* allocate(std::size_t size, std::size_t alignment = 0) {
+        if (counting.load(std::memory_order_relaxed) && !ignoreThread) {
+            allocations.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (size == 0) {
+            size = 1;
+        }
+        if (alignment > alignof(std::max_align_t)) {
+            // aligned_alloc wants a size that is a multiple of the alignment
+            return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+        }
+        return std::malloc(size);
+    }
+
+    [[gnu::noinline]] static void release(void* memory) noexcept {
+        std::free(memory);
+    }
+
+    static void* allocateOrThrow(std::size_t size, std::size_t alignment = 0) {
+        if (void* memory = allocate(size, alignment)) {
+            return memory;
+        }
+        throw std::bad_alloc();
+    }
+};
+
+void* operator new(std::size_t size) {
+    return AllocationCounter::allocateOrThrow(size);
+}
+
+void* operator new[](std::size_t size) {
+    return AllocationCounter::allocateOrThrow(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return AllocationCounter::allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return AllocationCounter::allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return AllocationCounter::allocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return AllocationCounter::allocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return AllocationCounter::allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return AllocationCounter::allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* memory) noexcept {
+    AllocationCounter::release(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    AllocationCounter::release(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    AllocationCounter::release(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+    AllocationCounter::release(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+    AllocationCounter::release(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+    AllocationCounter::release(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+    AllocationCounter::release(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept {
+    AllocationCounter::release(memory);
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept {
+    AllocationCounter::release(memory);
+}
+
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept {
+    AllocationCounter::release(memory);
+}
+
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept {
+    AllocationCounter::release(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept {
+    AllocationCounter::release(memory);
+}
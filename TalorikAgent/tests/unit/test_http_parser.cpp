@@ -0,0 +1,346 @@
+#include <gtest/gtest.h>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "network/HttpParser.h"
+
+namespace {
+
+// Feeds the head one byte more at a time, from a fresh copy each time so
+// the buffer moves between calls the way a growing connection buffer does.
+// Returns the first result that is not Incomplete.
+HttpParser::Result parseByteByByte(HttpParser& parser, const std::string& head, std::string& buffer) {
+    for (size_t size = 1; size <= head.size(); ++size) {
+        buffer = std::string(head, 0, size);
+        HttpParser::Result result = parser.parse(buffer);
+        if (result != HttpParser::Result::Incomplete) {
+            return result;
+        }
+    }
+    return HttpParser::Result::Incomplete;
+}
+
+std::string headers(size_t count) {
+    std::string out;
+    for (size_t i = 0; i < count; ++i) {
+        out += "X-Header-" + std::to_string(i) + ": " + std::to_string(i) + "\r\n";
+    }
+    return out;
+}
+
+struct RejectCase {
+    const char* name;
+    std::string head;
+    int status;
+};
+
+void PrintTo(const RejectCase& test, std::ostream* os) {
+    *os << test.name;
+}
+
+class HttpParserRejectTest : public ::testing::TestWithParam<RejectCase> {};
+
+}
+
+TEST_P(HttpParserRejectTest, RejectsWithStatus) {
+    const RejectCase& test = GetParam();
+
+    HttpParser whole;
+    ASSERT_EQ(whole.parse(test.head), HttpParser::Result::Error);
+    EXPECT_EQ(whole.errorStatus(), test.status);
+    EXPECT_STRNE(whole.errorReason(), "");
+
+    // The same verdict however the head is split, and it sticks
+    HttpParser split;
+    std::string buffer;
+    ASSERT_EQ(parseByteByByte(split, test.head, buffer), HttpParser::Result::Error);
+    EXPECT_EQ(split.errorStatus(), test.status);
+    EXPECT_EQ(split.parse(test.head), HttpParser::Result::Error);
+}
+
+INSTANTIATE_TEST_SUITE_P(Heads, HttpParserRejectTest, ::testing::Values(
+    RejectCase{"ObsFold", "GET / HTTP/1.1\r\nX-Long: first\r\n second\r\n\r\n", 400},
+    RejectCase{"ObsFoldTab", "GET / HTTP/1.1\r\nX-Long: first\r\n\tsecond\r\n\r\n", 400},
+    RejectCase{"MissingVersion", "GET /\r\n\r\n", 400},
+    RejectCase{"DoubleSpace", "GET  / HTTP/1.1\r\n\r\n", 400},
+    RejectCase{"TrailingField", "GET / HTTP/1.1 extra\r\n\r\n", 400},
+    RejectCase{"MethodNotToken", "G(T / HTTP/1.1\r\n\r\n", 400},
+    RejectCase{"RelativeTarget", "GET index.html HTTP/1.1\r\n\r\n", 400},
+    RejectCase{"HeaderWithoutColon", "GET / HTTP/1.1\r\nHost\r\n\r\n", 400},
+    RejectCase{"SpaceBeforeColon", "GET / HTTP/1.1\r\nHost : test\r\n\r\n", 400},
+    RejectCase{"EmptyHeaderName", "GET / HTTP/1.1\r\n: test\r\n\r\n", 400},
+    RejectCase{"LongRequestLine", "GET /" + std::string(HttpParser::kMaxRequestLine, 'a') + " HTTP/1.1\r\n\r\n", 414},
+    RejectCase{"LongUnterminatedRequestLine", "GET /" + std::string(HttpParser::kMaxRequestLine, 'a'), 414},
+    RejectCase{"LongHead", "GET / HTTP/1.1\r\nX-Big: " + std::string(HttpParser::kMaxHeadSize, 'a') + "\r\n\r\n", 431},
+    RejectCase{"LongUnterminatedHead", "GET / HTTP/1.1\r\nX-Big: " + std::string(HttpParser::kMaxHeadSize, 'a'), 431},
+    RejectCase{"TooManyHeaders", "GET / HTTP/1.1\r\n" + headers(HttpParser::kMaxHeaders + 1) + "\r\n", 431},
+    RejectCase{"Http2", "GET / HTTP/2.0\r\n\r\n", 505},
+    RejectCase{"Http12", "GET / HTTP/1.2\r\n\r\n", 505},
+    RejectCase{"LowercaseVersion", "GET / http/1.1\r\n\r\n", 505}
+), [](const ::testing::TestParamInfo<RejectCase>& info) { return std::string(info.param.name); });
+
+TEST(HttpParserTest, ParsesRequestLineAndHeaders) {
+    std::string head =
+        "GET /api/threats/data?range=24h&type=malware HTTP/1.1\r\n"
+        "Host: localhost:8080\r\n"
+        "Accept-Encoding:  gzip, deflate \t\r\n"
+        "X-Empty:\r\n"
+        "Connection: keep-alive, Upgrade\r\n"
+        "\r\n"
+        "body";
+    HttpParser parser;
+    ASSERT_EQ(parser.parse(head), HttpParser::Result::Complete);
+
+    EXPECT_EQ(parser.method(), "GET");
+    EXPECT_EQ(parser.target(), "/api/threats/data?range=24h&type=malware");
+    EXPECT_EQ(parser.path(), "/api/threats/data");
+    EXPECT_EQ(parser.query(), "range=24h&type=malware");
+    EXPECT_EQ(parser.version(), "HTTP/1.1");
+    EXPECT_EQ(parser.headSize(), head.size() - 4);
+
+    EXPECT_EQ(parser.headerCount(), 4u);
+    EXPECT_EQ(parser.headerAt(0).name, "Host");
+    EXPECT_EQ(parser.header("host"), "localhost:8080");
+    EXPECT_EQ(parser.header("ACCEPT-ENCODING"), "gzip, deflate");
+    EXPECT_EQ(parser.header("X-Empty"), "");
+    EXPECT_EQ(parser.header("Missing"), "");
+    EXPECT_TRUE(parser.headerHasToken("Connection", "upgrade"));
+    EXPECT_TRUE(parser.headerHasToken("Connection", "Keep-Alive"));
+    EXPECT_FALSE(parser.headerHasToken("Connection", "close"));
+}
+
+TEST(HttpParserTest, AcceptsLenientFraming) {
+    // Stray blank lines before the request line and bare LF line endings
+    HttpParser parser;
+    ASSERT_EQ(parser.parse("\r\n\nOPTIONS * HTTP/1.0\nHost: test\n\n"), HttpParser::Result::Complete);
+    EXPECT_EQ(parser.method(), "OPTIONS");
+    EXPECT_EQ(parser.target(), "*");
+    EXPECT_EQ(parser.version(), "HTTP/1.0");
+    EXPECT_EQ(parser.header("Host"), "test");
+}
+
+TEST(HttpParserTest, AcceptsTheMaximumHeaderCount) {
+    std::string head = "GET / HTTP/1.1\r\n" + headers(HttpParser::kMaxHeaders) + "\r\n";
+    HttpParser parser;
+    ASSERT_EQ(parser.parse(head), HttpParser::Result::Complete);
+    EXPECT_EQ(parser.headerCount(), HttpParser::kMaxHeaders);
+    EXPECT_EQ(parser.header("X-Header-31"), "31");
+}
+
+// Offsets, not pointers, are kept between calls, so a split head parses the
+// same whichever byte the first read ends on, even as the buffer moves
+TEST(HttpParserTest, ResumesAfterSplitRead) {
+    std::string head =
+        "POST /api/security/scan?deep=1 HTTP/1.1\r\n"
+        "Host: test\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: 2\r\n"
+        "\r\n";
+    HttpParser parser;
+    std::string buffer;
+    ASSERT_EQ(parseByteByByte(parser, head, buffer), HttpParser::Result::Complete);
+    EXPECT_EQ(parser.method(), "POST");
+    EXPECT_EQ(parser.path(), "/api/security/scan");
+    EXPECT_EQ(parser.query(), "deep=1");
+    EXPECT_EQ(parser.header("Content-Type"), "application/json");
+    EXPECT_EQ(parser.header("Content-Length"), "2");
+    EXPECT_EQ(parser.headSize(), head.size());
+
+    for (size_t split = 1; split < head.size(); ++split) {
+        HttpParser resumed;
+        std::string first(head, 0, split);
+        ASSERT_EQ(resumed.parse(first), HttpParser::Result::Incomplete) << "split at " << split;
+        ASSERT_EQ(resumed.parse(head), HttpParser::Result::Complete) << "split at " << split;
+        EXPECT_EQ(resumed.header("Host"), "test") << "split at " << split;
+        EXPECT_EQ(resumed.headSize(), head.size()) << "split at " << split;
+    }
+}
+
+TEST(HttpParserTest, ResetStartsTheNextRequest) {
+    std::string pipelined = "GET /first HTTP/1.1\r\n\r\nGET /second HTTP/1.1\r\nHost: b\r\n\r\n";
+    HttpParser parser;
+    ASSERT_EQ(parser.parse(pipelined), HttpParser::Result::Complete);
+    EXPECT_EQ(parser.path(), "/first");
+
+    std::string rest = pipelined.substr(parser.headSize());
+    parser.reset();
+    ASSERT_EQ(parser.parse(rest), HttpParser::Result::Complete);
+    EXPECT_EQ(parser.path(), "/second");
+    EXPECT_EQ(parser.header("Host"), "b");
+    EXPECT_EQ(parser.headSize(), rest.size());
+}
+
+namespace {
+
+struct Decoded {
+    HttpBodyParser::Result result = HttpBodyParser::Result::Incomplete;
+    std::string body;
+    std::string leftover;   // input after the end of the body
+};
+
+// Decodes reads in order, calling decode() the way the server does: again
+// while Incomplete and input is left. Once the body ends the rest of the
+// reads are leftover.
+Decoded decodeReads(HttpBodyParser& parser, const std::vector<std::string_view>& reads) {
+    Decoded decoded;
+    for (std::string_view input : reads) {
+        if (decoded.result != HttpBodyParser::Result::Incomplete) {
+            decoded.leftover.append(input);
+            continue;
+        }
+        do {
+            std::string_view piece;
+            decoded.result = parser.decode(input, piece);
+            decoded.body.append(piece);
+        } while (decoded.result == HttpBodyParser::Result::Incomplete && !input.empty());
+        decoded.leftover.append(input);
+    }
+    return decoded;
+}
+
+Decoded decodeSplit(HttpBodyParser& parser, std::string_view data, size_t split) {
+    return decodeReads(parser, {data.substr(0, split), data.substr(split)});
+}
+
+Decoded decodeByteByByte(HttpBodyParser& parser, std::string_view data) {
+    std::vector<std::string_view> reads;
+    for (size_t i = 0; i < data.size(); ++i) {
+        reads.push_back(data.substr(i, 1));
+    }
+    return decodeReads(parser, reads);
+}
+
+struct ChunkedCase {
+    const char* name;
+    std::string framed;
+    std::string body;       // expected body, when accepted
+    bool accepted;
+};
+
+void PrintTo(const ChunkedCase& test, std::ostream* os) {
+    *os << test.name;
+}
+
+class HttpBodyParserChunkedTest : public ::testing::TestWithParam<ChunkedCase> {};
+
+}
+
+// Framing bytes may split anywhere, so every case is decoded whole, split
+// in two at every offset, and one byte at a time; all must agree
+TEST_P(HttpBodyParserChunkedTest, DecodesAtEverySplit) {
+    const ChunkedCase& test = GetParam();
+    // Bytes of the next pipelined request must be left alone
+    const std::string next = "GET / HTTP/1.1\r\n\r\n";
+    std::string data = test.framed + next;
+
+    auto check = [&](const Decoded& decoded, const std::string& how) {
+        if (test.accepted) {
+            EXPECT_EQ(decoded.result, HttpBodyParser::Result::Complete) << how;
+            EXPECT_EQ(decoded.body, test.body) << how;
+            EXPECT_EQ(decoded.leftover, next) << how;
+        } else {
+            EXPECT_EQ(decoded.result, HttpBodyParser::Result::Error) << how;
+        }
+    };
+
+    for (size_t split = 0; split <= data.size(); ++split) {
+        HttpBodyParser parser;
+        parser.startChunked();
+        check(decodeSplit(parser, data, split), "split at " + std::to_string(split));
+    }
+
+    HttpBodyParser parser;
+    parser.startChunked();
+    Decoded decoded = decodeByteByByte(parser, data);
+    check(decoded, "byte by byte");
+    if (test.accepted) {
+        EXPECT_EQ(parser.bodySize(), test.body.size());
+    }
+
+    // Once decided, the outcome sticks
+    std::string_view more = "1\r\nx\r\n";
+    std::string_view piece;
+    EXPECT_EQ(parser.decode(more, piece), decoded.result);
+    EXPECT_TRUE(piece.empty());
+}
+
+INSTANTIATE_TEST_SUITE_P(Bodies, HttpBodyParserChunkedTest, ::testing::Values(
+    ChunkedCase{"Empty", "0\r\n\r\n", "", true},
+    ChunkedCase{"OneChunk", "b\r\nhello world\r\n0\r\n\r\n", "hello world", true},
+    ChunkedCase{"SeveralChunks", "5\r\nhello\r\n1\r\n \r\n5\r\nworld\r\n0\r\n\r\n", "hello world", true},
+    ChunkedCase{"UppercaseHex", "A\r\n0123456789\r\n0\r\n\r\n", "0123456789", true},
+    ChunkedCase{"LeadingZeros", "0005\r\nhello\r\n000\r\n\r\n", "hello", true},
+    ChunkedCase{"Extensions", "5;name=value\r\nhello\r\n6 ; quoted=\"a;b\"\r\n world\r\n0;last\r\n\r\n",
+                "hello world", true},
+    ChunkedCase{"Trailers", "5\r\nhello\r\n0\r\nX-Checksum: abc\r\nX-Other: 1\r\n\r\n", "hello", true},
+    ChunkedCase{"CrlfInsideData", "4\r\n\r\n\r\n\r\n0\r\n\r\n", "\r\n\r\n", true},
+    ChunkedCase{"SizeOverflow", "10000000000000000\r\n", "", false},
+    ChunkedCase{"SizeOverflowAfterZeros", "000000000000000010000000000000000\r\n", "", false},
+    ChunkedCase{"MissingSize", "\r\nhello\r\n0\r\n\r\n", "", false},
+    ChunkedCase{"ExtensionWithoutSize", ";ext\r\nhello\r\n0\r\n\r\n", "", false},
+    ChunkedCase{"NotHex", "5g\r\nhello\r\n0\r\n\r\n", "", false},
+    ChunkedCase{"NegativeSize", "-5\r\nhello\r\n0\r\n\r\n", "", false},
+    ChunkedCase{"BareLfAfterSize", "5\nhello\r\n0\r\n\r\n", "", false},
+    ChunkedCase{"CrWithoutLfAfterSize", "5\rhello\r\n0\r\n\r\n", "", false},
+    ChunkedCase{"DataLongerThanSize", "5\r\nhello!\r\n0\r\n\r\n", "", false},
+    ChunkedCase{"MissingCrlfAfterData", "5\r\nhello0\r\n\r\n", "", false},
+    ChunkedCase{"CrWithoutLfAfterData", "5\r\nhello\r0\r\n\r\n", "", false},
+    ChunkedCase{"BareCrEndingTrailers", "0\r\n\rX", "", false}
+), [](const ::testing::TestParamInfo<ChunkedCase>& info) { return std::string(info.param.name); });
+
+TEST(HttpBodyParserTest, LargestChunkSizeIsNotAnOverflow) {
+    HttpBodyParser parser;
+    parser.startChunked();
+    std::string_view input = "ffffffffffffffff\r\nabc";
+    std::string_view piece;
+    EXPECT_EQ(parser.decode(input, piece), HttpBodyParser::Result::Incomplete);
+    while (!input.empty()) {
+        EXPECT_EQ(parser.decode(input, piece), HttpBodyParser::Result::Incomplete);
+    }
+    EXPECT_EQ(parser.bodySize(), 3u);
+}
+
+TEST(HttpBodyParserTest, ContentLengthStopsAtTheLength) {
+    std::string data = "hello world" "GET / HTTP/1.1\r\n\r\n";
+    for (size_t split = 0; split <= data.size(); ++split) {
+        HttpBodyParser parser;
+        parser.startContentLength(11);
+        Decoded decoded = decodeSplit(parser, data, split);
+        EXPECT_EQ(decoded.result, HttpBodyParser::Result::Complete) << "split at " << split;
+        EXPECT_EQ(decoded.body, "hello world") << "split at " << split;
+        EXPECT_EQ(decoded.leftover, "GET / HTTP/1.1\r\n\r\n") << "split at " << split;
+        EXPECT_EQ(parser.bodySize(), 11u);
+    }
+}
+
+TEST(HttpBodyParserTest, ContentLengthWaitsForTheRest) {
+    HttpBodyParser parser;
+    parser.startContentLength(10);
+    Decoded decoded = decodeReads(parser, {"hello"});
+    EXPECT_EQ(decoded.result, HttpBodyParser::Result::Incomplete);
+    EXPECT_EQ(decoded.body, "hello");
+    EXPECT_EQ(parser.bodySize(), 5u);
+}
+
+TEST(HttpBodyParserTest, ZeroLengthIsCompleteAtOnce) {
+    HttpBodyParser parser;
+    parser.startContentLength(0);
+    std::string_view input = "GET";
+    std::string_view piece;
+    EXPECT_EQ(parser.decode(input, piece), HttpBodyParser::Result::Complete);
+    EXPECT_EQ(input, "GET");
+    EXPECT_TRUE(piece.empty());
+}
+
+TEST(HttpBodyParserTest, RestartsForTheNextBody) {
+    HttpBodyParser parser;
+    parser.startChunked();
+    EXPECT_EQ(decodeReads(parser, {"zz\r\n"}).result, HttpBodyParser::Result::Error);
+
+    parser.startChunked();
+    Decoded decoded = decodeReads(parser, {"3\r\nabc\r\n0\r\n\r\n"});
+    EXPECT_EQ(decoded.result, HttpBodyParser::Result::Complete);
+    EXPECT_EQ(decoded.body, "abc");
+    EXPECT_EQ(parser.bodySize(), 3u);
+}
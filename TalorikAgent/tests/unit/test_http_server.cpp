@@ -0,0 +1,423 @@
+#include <gtest/gtest.h>
+#include <asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "network/HttpServer.h"
+#include "support/AllocationCounter.h"
+
+namespace {
+
+int freePort() {
+    asio::io_context ioContext;
+    asio::ip::tcp::acceptor acceptor(ioContext, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    return acceptor.local_endpoint().port();
+}
+
+// Blocking keep-alive client that reuses its buffers between requests
+class Client {
+public:
+    explicit Client(int port)
+        : Client(asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), static_cast<unsigned short>(port))) {}
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+    explicit Client(const std::string& socketPath) : Client(asio::local::stream_protocol::endpoint(socketPath)) {}
+#endif
+
+    // Status code of the response; the head and body are kept until the next one
+    int get(const std::string& request) {
+        asio::write(m_socket, asio::buffer(request));
+        size_t headEnd = asio::read_until(m_socket, asio::dynamic_buffer(m_buffer), "\r\n\r\n");
+
+        size_t contentLength = 0;
+        size_t field = m_buffer.find("Content-Length: ");
+        if (field != std::string::npos && field < headEnd) {
+            contentLength = std::strtoul(m_buffer.c_str() + field + 16, nullptr, 10);
+        }
+        if (m_buffer.size() < headEnd + contentLength) {
+            asio::read(m_socket, asio::dynamic_buffer(m_buffer), asio::transfer_exactly(headEnd + contentLength - m_buffer.size()));
+        }
+        lastHead.assign(m_buffer, 0, headEnd);
+        size_t etag = m_buffer.find("ETag: ");
+        if (etag != std::string::npos && etag < headEnd) {
+            lastETag.assign(m_buffer, etag + 6, m_buffer.find("\r\n", etag) - etag - 6);
+        }
+        lastBody.assign(m_buffer, headEnd, contentLength);
+        int status = std::atoi(m_buffer.c_str() + 9);
+        m_buffer.erase(0, headEnd + contentLength);
+        return status;
+    }
+
+    std::string lastETag;
+    std::string lastHead;
+    std::string lastBody;
+
+private:
+    explicit Client(const asio::generic::stream_protocol::endpoint& endpoint) : m_socket(m_ioContext) {
+        m_socket.connect(endpoint);
+    }
+
+    asio::io_context m_ioContext;
+    asio::generic::stream_protocol::socket m_socket;
+    std::string m_buffer;
+};
+
+// One worker, with io_uring on or off
+class HttpServerAllocationTest : public ::testing::TestWithParam<bool> {
+protected:
+    void SetUp() override {
+        AllocationCounter::ignoreThread = true;
+
+        HttpServer::Options options;
+        options.port = freePort();
+        options.workerThreads = 1;
+        options.ioUring = GetParam();
+        m_port = options.port;
+        m_server = std::make_unique<HttpServer>(options);
+
+        HttpServer::RouteOptions cached;
+        cached.cacheVersion = []() { return uint64_t(1); };
+        m_server->addRoute("GET", "/api/cached", [](const HttpServer::HttpRequest&) {
+            return std::string(2048, 'x');
+        }, cached);
+        m_server->start();
+        if (GetParam() && m_server->getIoBackend() != "io_uring") {
+            GTEST_SKIP() << "io_uring is not available here";
+        }
+    }
+
+    void TearDown() override {
+        m_server->stop();
+    }
+
+    // Allocations per request over count keep-alive requests, after a
+    // warmup that fills the cache and the server's reusable buffers
+    double allocationsPerRequest(const std::string& request, int expectedStatus, int count) {
+        Client client(m_port);
+        for (int i = 0; i < 100; ++i) {
+            EXPECT_EQ(client.get(request), expectedStatus);
+        }
+
+        AllocationCounter::allocations = 0;
+        AllocationCounter::counting = true;
+        for (int i = 0; i < count; ++i) {
+            if (client.get(request) != expectedStatus) {
+                ADD_FAILURE() << "unexpected status on request " << i;
+                break;
+            }
+        }
+        AllocationCounter::counting = false;
+        return static_cast<double>(AllocationCounter::allocations.load()) / count;
+    }
+
+    int m_port = 0;
+    std::unique_ptr<HttpServer> m_server;
+};
+
+}
+
+// Cache hits are answered from the connection's arena and handler memory;
+// the only heap use left is the worker's dispatch queue growing a chunk now
+// and then
+TEST_P(HttpServerAllocationTest, CachedKeepAliveRequestsDoNotAllocate) {
+    double perRequest = allocationsPerRequest("GET /api/cached HTTP/1.1\r\nHost: test\r\n\r\n", 200, 2000);
+    EXPECT_LT(perRequest, 0.25);
+}
+
+TEST_P(HttpServerAllocationTest, CompressedCachedRequestsDoNotAllocate) {
+    double perRequest = allocationsPerRequest(
+        "GET /api/cached HTTP/1.1\r\nHost: test\r\nAccept-Encoding: gzip\r\n\r\n", 200, 2000);
+    EXPECT_LT(perRequest, 0.25);
+}
+
+TEST_P(HttpServerAllocationTest, RevalidatedRequestsDoNotAllocate) {
+    Client client(m_port);
+    ASSERT_EQ(client.get("GET /api/cached HTTP/1.1\r\nHost: test\r\n\r\n"), 200);
+    ASSERT_FALSE(client.lastETag.empty());
+    
+    double perRequest = allocationsPerRequest(
+        "GET /api/cached HTTP/1.1\r\nHost: test\r\nIf-None-Match: " + client.lastETag + "\r\n\r\n", 304, 2000);
+    EXPECT_LT(perRequest, 0.25);
+}
+
+// Revalidating the gzip copy answers with that copy's validator, and says
+// the representation depends on Accept-Encoding
+TEST_P(HttpServerAllocationTest, RevalidatedCompressedCopyEchoesItsETag) {
+    Client client(m_port);
+    const std::string request = "GET /api/cached HTTP/1.1\r\nHost: test\r\nAccept-Encoding: gzip\r\n";
+    ASSERT_EQ(client.get(request + "\r\n"), 200);
+    ASSERT_NE(client.lastHead.find("Content-Encoding: gzip"), std::string::npos);
+    std::string gzipETag = client.lastETag;
+    
+    ASSERT_EQ(client.get(request + "If-None-Match: " + gzipETag + "\r\n\r\n"), 304);
+    EXPECT_EQ(client.lastETag, gzipETag);
+    EXPECT_NE(client.lastHead.find("Vary: Accept-Encoding"), std::string::npos) << client.lastHead;
+}
+
+INSTANTIATE_TEST_SUITE_P(Backends, HttpServerAllocationTest, ::testing::Values(false, true),
+                         [](const ::testing::TestParamInfo<bool>& info) {
+                             return info.param ? "IoUring" : "Reactor";
+                         });
+
+
+// A responder may be kept past the server's life; calling it then does
+// nothing, and the connection it held is released without the io_context
+TEST(HttpServerResponderTest, SendAfterStopIsDropped) {
+    HttpServer::Options options;
+    options.port = freePort();
+    options.workerThreads = 1;
+    auto server = std::make_unique<HttpServer>(options);
+
+    std::promise<HttpServer::Responder> held;
+    server->addAsyncRoute("GET", "/api/slow", [&held](const HttpServer::HttpRequest&, HttpServer::Responder responder) {
+        held.set_value(responder);
+    }, HttpServer::RouteOptions{});
+    server->start();
+
+    asio::io_context ioContext;
+    asio::ip::tcp::socket socket(ioContext);
+    socket.connect(asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), static_cast<unsigned short>(options.port)));
+    asio::write(socket, asio::buffer(std::string("GET /api/slow HTTP/1.1\r\nHost: test\r\n\r\n")));
+
+    std::optional<HttpServer::Responder> responder(held.get_future().get());
+    server->stop();
+    server.reset();
+
+    responder->send("late");
+    responder.reset();
+}
+
+
+namespace {
+
+// Processor time used by the whole process
+std::chrono::microseconds cpuTime() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return std::chrono::seconds(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+           std::chrono::microseconds(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+}
+
+class HttpServerAcceptTest : public ::testing::TestWithParam<bool> {};
+
+// Out of descriptors, a connection waits in the backlog and accept fails
+// until one is freed. The server must wait between attempts rather than
+// spin, and pick the connection up once it can.
+TEST_P(HttpServerAcceptTest, BacksOffWhileOutOfDescriptors) {
+    HttpServer::Options options;
+    options.port = freePort();
+    options.workerThreads = 1;
+    options.ioUring = GetParam();
+    HttpServer server(options);
+    server.addRoute("GET", "/api/ping", [](const HttpServer::HttpRequest&) {
+        return std::string("pong");
+    }, HttpServer::RouteOptions{});
+    server.start();
+    if (GetParam() && server.getIoBackend() != "io_uring") {
+        server.stop();
+        GTEST_SKIP() << "io_uring is not available here";
+    }
+
+    asio::io_context ioContext;
+    asio::ip::tcp::socket socket(ioContext);
+    socket.open(asio::ip::tcp::v4());
+
+    // Take every descriptor left under a lowered limit
+    rlimit original{};
+    getrlimit(RLIMIT_NOFILE, &original);
+    rlimit lowered = original;
+    lowered.rlim_cur = 256;
+    ASSERT_EQ(setrlimit(RLIMIT_NOFILE, &lowered), 0);
+    std::vector<int> filler;
+    for (int fd = dup(0); fd >= 0; fd = dup(0)) {
+        filler.push_back(fd);
+    }
+
+    socket.connect(asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), static_cast<unsigned short>(options.port)));
+    auto before = cpuTime();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    auto used = cpuTime() - before;
+
+    for (int fd : filler) {
+        close(fd);
+    }
+    setrlimit(RLIMIT_NOFILE, &original);
+    EXPECT_LT(std::chrono::duration_cast<std::chrono::milliseconds>(used).count(), 100) << "ms of CPU while waiting";
+
+    std::string request = "GET /api/ping HTTP/1.1\r\nHost: test\r\nConnection: close\r\n\r\n";
+    asio::write(socket, asio::buffer(request));
+    std::string response;
+    asio::error_code ec;
+    asio::read(socket, asio::dynamic_buffer(response), ec);
+    EXPECT_EQ(response.compare(0, 12, "HTTP/1.1 200"), 0) << response;
+
+    server.stop();
+}
+
+INSTANTIATE_TEST_SUITE_P(Backends, HttpServerAcceptTest, ::testing::Values(false, true),
+                         [](const ::testing::TestParamInfo<bool>& info) {
+                             return info.param ? "IoUring" : "Reactor";
+                         });
+
+
+// A file missing from the cache is streamed from the handler pool while it
+// is read and compressed in the background; later requests get the cached
+// compressed form
+TEST(HttpServerStaticFilesTest, MissIsStreamedThenCached) {
+    auto directory = std::filesystem::temp_directory_path() / ("static_files_test_" + std::to_string(getpid()));
+    std::filesystem::create_directories(directory);
+    {
+        std::ofstream out(directory / "app.js");
+        for (int i = 0; i < 400; ++i) {
+            out << "console.log('static file line " << i << "');\n";
+        }
+    }
+
+    HttpServer::Options options;
+    options.port = freePort();
+    options.workerThreads = 1;
+    HttpServer server(options);
+    server.addStaticRoute("/static", directory.string());
+    server.start();
+
+    Client client(options.port);
+    const std::string request = "GET /static/app.js HTTP/1.1\r\nHost: test\r\nAccept-Encoding: gzip\r\n\r\n";
+    ASSERT_EQ(client.get(request), 200);
+    EXPECT_EQ(client.lastHead.find("Content-Encoding"), std::string::npos) << client.lastHead;
+
+    bool compressed = false;
+    for (int i = 0; i < 200 && !compressed; ++i) {
+        ASSERT_EQ(client.get(request), 200);
+        compressed = client.lastHead.find("Content-Encoding: gzip") != std::string::npos;
+        if (!compressed) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+    EXPECT_TRUE(compressed);
+    EXPECT_EQ(client.get("GET /static/missing.js HTTP/1.1\r\nHost: test\r\n\r\n"), 404);
+
+    server.stop();
+    std::filesystem::remove_all(directory);
+}
+
+
+// A route's validator answers 400 before the cache or the handler is
+// reached, on the io thread and offloaded routes alike
+TEST(HttpServerValidateTest, RejectedRequestsAreNeitherHandledNorCached) {
+    HttpServer::Options options;
+    options.port = freePort();
+    options.workerThreads = 1;
+    HttpServer server(options);
+
+    std::atomic<int> handled{0};
+    HttpServer::RouteOptions route;
+    route.cacheVersion = []() { return uint64_t(1); };
+    route.validate = [](const HttpServer::HttpRequest& request, std::string& error) {
+        if (request.params.get("name") == "ok") {
+            return true;
+        }
+        error = "Unknown name: " + std::string(request.params.get("name"));
+        return false;
+    };
+    for (bool offload : {false, true}) {
+        route.offload = offload;
+        server.addRoute("GET", offload ? "/api/offloaded" : "/api/inline", [&handled](const HttpServer::HttpRequest&) {
+            handled++;
+            return std::string("{}");
+        }, route);
+    }
+    server.start();
+
+    Client client(options.port);
+    for (const char* path : {"/api/inline", "/api/offloaded"}) {
+        std::string bad = std::string("GET ") + path + "?name=%22x HTTP/1.1\r\nHost: test\r\n\r\n";
+        EXPECT_EQ(client.get(bad), 400) << path;
+        EXPECT_EQ(client.lastHead.find("ETag"), std::string::npos) << path;
+        EXPECT_EQ(client.get(bad), 400) << path;
+        EXPECT_EQ(client.get(std::string("GET ") + path + "?name=ok HTTP/1.1\r\nHost: test\r\n\r\n"), 200) << path;
+    }
+    EXPECT_EQ(handled, 2);
+
+    server.stop();
+}
+
+// Chunked bodies reach the handler decoded; a request framed both ways is
+// refused, since proxies and the server could disagree on where it ends
+TEST(HttpServerBodyTest, ChunkedBodiesAndAmbiguousFraming) {
+    HttpServer::Options options;
+    options.port = freePort();
+    options.workerThreads = 1;
+    HttpServer server(options);
+    server.addRoute("POST", "/api/echo", [](const HttpServer::HttpRequest& request) {
+        return std::string(request.body);
+    });
+    server.start();
+
+    Client client(options.port);
+    EXPECT_EQ(client.get("POST /api/echo HTTP/1.1\r\nHost: test\r\nTransfer-Encoding: chunked\r\n\r\n"
+                         "5;ext=1\r\nhello\r\n6\r\n world\r\n0\r\nX-Trailer: 1\r\n\r\n"), 200);
+    EXPECT_EQ(client.lastBody, "hello world");
+    EXPECT_EQ(client.get("POST /api/echo HTTP/1.1\r\nHost: test\r\nContent-Length: 5\r\n\r\nhello"), 200);
+    EXPECT_EQ(client.lastBody, "hello");
+
+    const char* refused[] = {
+        "POST /api/echo HTTP/1.1\r\nHost: test\r\nContent-Length: 5\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "0\r\n\r\n",
+        "POST /api/echo HTTP/1.1\r\nHost: test\r\nTransfer-Encoding: chunked\r\nContent-Length: 0\r\n\r\n"
+        "5\r\nhello\r\n0\r\n\r\n",
+        "POST /api/echo HTTP/1.1\r\nHost: test\r\nTransfer-Encoding: gzip, chunked\r\n\r\n0\r\n\r\n",
+        "POST /api/echo HTTP/1.1\r\nHost: test\r\nContent-Length: 5x\r\n\r\nhello",
+        "POST /api/echo HTTP/1.1\r\nHost: test\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhelloXX0\r\n\r\n",
+    };
+    for (const char* request : refused) {
+        Client fresh(options.port);
+        EXPECT_EQ(fresh.get(request), 400) << request;
+    }
+
+    server.stop();
+}
+
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+// Unix socket clients are rate limited by user, not as 127.0.0.1, so they
+// neither spend nor are refused by the loopback TCP clients' bucket
+TEST(HttpServerRateLimitTest, UnixSocketClientsHaveTheirOwnBucket) {
+    std::string socketPath = (std::filesystem::temp_directory_path() /
+                              ("http_server_test_" + std::to_string(::getpid()) + ".sock")).string();
+    HttpServer::Options options;
+    options.port = freePort();
+    options.workerThreads = 1;
+    options.rateLimit = 1;
+    options.rateBurst = 1;
+    options.unixSocketPath = socketPath;
+    HttpServer server(options);
+    server.addRoute("GET", "/api/limited", [](const HttpServer::HttpRequest&) {
+        return std::string("{}");
+    });
+    server.start();
+
+    const std::string request = "GET /api/limited HTTP/1.1\r\nHost: test\r\n\r\n";
+    Client tcp(options.port);
+    EXPECT_EQ(tcp.get(request), 200);
+    EXPECT_EQ(tcp.get(request), 429);
+
+    Client local(socketPath);
+    EXPECT_EQ(local.get(request), 200);
+    EXPECT_EQ(local.get(request), 429);
+
+    // Another connection by the same user shares its bucket
+    Client again(socketPath);
+    EXPECT_EQ(again.get(request), 429);
+
+    server.stop();
+}
+#endif
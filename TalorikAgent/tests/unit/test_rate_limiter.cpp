@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "network/RateLimiter.h"
+
+TEST(RateLimiterTest, BurstThenRefuses) {
+    RateLimiter limiter;
+    double retryAfter = 0;
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_TRUE(limiter.tryAcquire(42, 1.0, 5.0, retryAfter)) << "request " << i;
+    }
+    EXPECT_FALSE(limiter.tryAcquire(42, 1.0, 5.0, retryAfter));
+    EXPECT_GT(retryAfter, 0.0);
+    EXPECT_LE(retryAfter, 1.0);
+
+    // Other keys have their own buckets
+    EXPECT_TRUE(limiter.tryAcquire(43, 1.0, 5.0, retryAfter));
+}
+
+TEST(RateLimiterTest, RefillsAtRate) {
+    RateLimiter limiter;
+    double retryAfter = 0;
+    while (limiter.tryAcquire(7, 100.0, 1.0, retryAfter)) {
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    EXPECT_TRUE(limiter.tryAcquire(7, 100.0, 1.0, retryAfter));
+}
+
+// Threads racing on one bucket store each other's timestamps; a refill must
+// never treat a newer stored time as ~49 days ago
+TEST(RateLimiterTest, ConcurrentAcquisitionsStayWithinRate) {
+    const double rate = 200.0;
+    const double burst = 20.0;
+    const size_t threadCount = std::max(4u, std::thread::hardware_concurrency());
+
+    RateLimiter limiter;
+    std::atomic<bool> go{false};
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> granted{0};
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < threadCount; ++i) {
+        threads.emplace_back([&]() {
+            while (!go.load()) {
+            }
+            double retryAfter = 0;
+            uint64_t mine = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                if (limiter.tryAcquire(99, rate, burst, retryAfter)) {
+                    ++mine;
+                }
+            }
+            granted += mine;
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    go = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    stop = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Allow for the limiter's millisecond clock starting up to 2 ms early
+    double limit = burst + rate * (seconds + 0.002);
+    EXPECT_LE(static_cast<double>(granted.load()), limit);
+    EXPECT_GE(static_cast<double>(granted.load()), burst);
+}
@@ -0,0 +1,225 @@
+#include <gtest/gtest.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include "network/Router.h"
+
+namespace {
+
+struct Lookup {
+    Router::MatchStatus status;
+    size_t routeId;
+    RouteParams params;
+};
+
+Lookup lookup(const Router& router, std::string_view method, std::string_view path) {
+    Lookup result{};
+    Router::Match match = router.match(method, path, result.params);
+    result.status = match.status;
+    result.routeId = match.routeId;
+    return result;
+}
+
+}
+
+TEST(RouterTest, StaticSegmentsBeatParameters) {
+    Router router;
+    router.add("GET", "/api/alerts/{id}", 1);
+    router.add("GET", "/api/alerts/recent", 2);
+
+    Lookup recent = lookup(router, "GET", "/api/alerts/recent");
+    EXPECT_EQ(recent.status, Router::MatchStatus::Found);
+    EXPECT_EQ(recent.routeId, 2u);
+    EXPECT_EQ(recent.params.size(), 0u);
+
+    Lookup byId = lookup(router, "GET", "/api/alerts/42");
+    EXPECT_EQ(byId.routeId, 1u);
+    EXPECT_EQ(byId.params.get("id"), "42");
+
+    // A static edge that only matches a prefix falls back to the parameter
+    Lookup longer = lookup(router, "GET", "/api/alerts/recently");
+    EXPECT_EQ(longer.status, Router::MatchStatus::Found);
+    EXPECT_EQ(longer.routeId, 1u);
+    EXPECT_EQ(longer.params.get("id"), "recently");
+}
+
+TEST(RouterTest, CatchAllIsTriedLast) {
+    Router router;
+    router.add("GET", "/static/{path*}", 1);
+    router.add("GET", "/static/{file}", 2);
+    router.add("GET", "/static/app.js", 3);
+
+    EXPECT_EQ(lookup(router, "GET", "/static/app.js").routeId, 3u);
+
+    Lookup file = lookup(router, "GET", "/static/site.css");
+    EXPECT_EQ(file.routeId, 2u);
+    EXPECT_EQ(file.params.get("file"), "site.css");
+
+    Lookup nested = lookup(router, "GET", "/static/css/site.css");
+    EXPECT_EQ(nested.routeId, 1u);
+    EXPECT_EQ(nested.params.get("path"), "css/site.css");
+    EXPECT_FALSE(nested.params.has("file"));
+
+    Lookup empty = lookup(router, "GET", "/static/");
+    EXPECT_EQ(empty.status, Router::MatchStatus::Found);
+    EXPECT_EQ(empty.routeId, 1u);
+    EXPECT_TRUE(empty.params.has("path"));
+    EXPECT_EQ(empty.params.get("path"), "");
+}
+
+TEST(RouterTest, RootCatchAllTakesWhatNothingElseMatches) {
+    Router router;
+    router.add("GET", "/{path*}", 1);
+    router.add("GET", "/api/security/metrics", 2);
+
+    EXPECT_EQ(lookup(router, "GET", "/api/security/metrics").routeId, 2u);
+    EXPECT_EQ(lookup(router, "GET", "/api/security/metrics/more").params.get("path"), "api/security/metrics/more");
+    EXPECT_EQ(lookup(router, "GET", "/api/security").params.get("path"), "api/security");
+
+    Lookup root = lookup(router, "GET", "/");
+    EXPECT_EQ(root.status, Router::MatchStatus::Found);
+    EXPECT_EQ(root.routeId, 1u);
+    EXPECT_EQ(root.params.get("path"), "");
+}
+
+// Parameters captured on a branch that did not match are dropped
+TEST(RouterTest, BacktrackingDropsParameters) {
+    Router router;
+    router.add("GET", "/agents/{agent}/tasks", 1);
+    router.add("GET", "/agents/{rest*}", 2);
+
+    Lookup tasks = lookup(router, "GET", "/agents/7/tasks");
+    EXPECT_EQ(tasks.routeId, 1u);
+    EXPECT_EQ(tasks.params.get("agent"), "7");
+
+    Lookup other = lookup(router, "GET", "/agents/7/logs");
+    EXPECT_EQ(other.routeId, 2u);
+    EXPECT_EQ(other.params.size(), 1u);
+    EXPECT_FALSE(other.params.has("agent"));
+    EXPECT_EQ(other.params.get("rest"), "7/logs");
+}
+
+TEST(RouterTest, KnownPathWithOtherMethodIsNotAllowed) {
+    Router router;
+    router.add("GET", "/api/alerts/{id}", 1);
+    router.add("DELETE", "/api/alerts/{id}", 2);
+    router.add("POST", "/api/security/scan", 3);
+
+    EXPECT_EQ(lookup(router, "DELETE", "/api/alerts/9").routeId, 2u);
+    EXPECT_EQ(lookup(router, "PUT", "/api/alerts/9").status, Router::MatchStatus::MethodNotAllowed);
+    EXPECT_EQ(lookup(router, "GET", "/api/security/scan").status, Router::MatchStatus::MethodNotAllowed);
+
+    // Methods are case-sensitive
+    EXPECT_EQ(lookup(router, "post", "/api/security/scan").status, Router::MatchStatus::MethodNotAllowed);
+
+    EXPECT_EQ(lookup(router, "GET", "/api/security").status, Router::MatchStatus::NotFound);
+    EXPECT_EQ(lookup(router, "GET", "/api/security/scans").status, Router::MatchStatus::NotFound);
+    EXPECT_EQ(lookup(router, "GET", "/api/alerts/").status, Router::MatchStatus::NotFound);
+    EXPECT_EQ(lookup(router, "GET", "/api/alerts/9/extra").status, Router::MatchStatus::NotFound);
+    EXPECT_EQ(lookup(router, "GET", "").status, Router::MatchStatus::NotFound);
+}
+
+TEST(RouterTest, AddingAgainReplacesTheRoute) {
+    Router router;
+    router.add("GET", "/api/agent/status", 1);
+    router.add("GET", "/api/agent/status", 2);
+    EXPECT_EQ(lookup(router, "GET", "/api/agent/status").routeId, 2u);
+}
+
+TEST(RouterTest, RejectsMalformedTemplates) {
+    Router router;
+    router.add("GET", "/x/{a}", 1);
+    router.add("GET", "/y/{rest*}", 2);
+
+    for (const char* bad : {"", "api", "/a{b}", "/{}", "/{a}b", "/{a", "/{a*}/x", "/{*}", "/x/{b}", "/y/{other*}"}) {
+        EXPECT_THROW(router.add("GET", bad, 3), std::invalid_argument) << bad;
+    }
+}
+
+TEST(RouterTest, KeepsAtMostMaxParams) {
+    std::string pathTemplate;
+    std::string path;
+    for (size_t i = 0; i <= RouteParams::kMaxParams; ++i) {
+        pathTemplate += "/{p" + std::to_string(i) + "}";
+        path += "/" + std::to_string(i);
+    }
+    Router router;
+    router.add("GET", pathTemplate, 1);
+
+    Lookup many = lookup(router, "GET", path);
+    EXPECT_EQ(many.status, Router::MatchStatus::Found);
+    EXPECT_EQ(many.params.size(), RouteParams::kMaxParams);
+    EXPECT_EQ(many.params.get("p15"), "15");
+    EXPECT_FALSE(many.params.has("p16"));
+
+    // Query parameters are dropped the same way once the array is full
+    many.params.parseQuery("extra=1");
+    EXPECT_FALSE(many.params.has("extra"));
+}
+
+TEST(RouteParamsTest, DecodesQueryParameters) {
+    RouteParams params;
+    params.add("id", "7");
+    params.parseQuery("id=8&q=a%20b+c&raw=plain&bad=%zz%4&empty=&=skipped&novalue&n=-12&x=1x");
+
+    EXPECT_EQ(params.get("id"), "7");   // path parameters win
+    EXPECT_EQ(params.get("q"), "a b c");
+    EXPECT_EQ(params.get("raw"), "plain");
+    EXPECT_EQ(params.get("bad"), "%zz%4");
+    EXPECT_TRUE(params.has("empty"));
+    EXPECT_EQ(params.get("empty"), "");
+    EXPECT_FALSE(params.has(""));
+    EXPECT_FALSE(params.has("novalue"));
+    EXPECT_EQ(params.get("missing", "default"), "default");
+
+    EXPECT_EQ(params.getInt("n"), -12);
+    EXPECT_EQ(params.getInt("x", 5), 5);
+    EXPECT_EQ(params.getInt("missing", 3), 3);
+}
+
+TEST(RouteParamsTest, DecodesNames) {
+    RouteParams params;
+    params.parseQuery("first%20name=Ada&last+name=Lovelace");
+    EXPECT_EQ(params.get("first name"), "Ada");
+    EXPECT_EQ(params.get("last name"), "Lovelace");
+}
+
+// Decoded values live in the params' own buffer; copies must point into
+// theirs, not the original's, or they change when the original is reused
+TEST(RouteParamsTest, CopiesOwnTheirDecodedValues) {
+    auto original = std::make_unique<RouteParams>();
+    original->add("id", "7");
+    original->parseQuery("q=a%20b&name=x+y");
+
+    RouteParams copied(*original);
+    RouteParams assigned;
+    assigned.parseQuery("old=%41");
+    assigned = *original;
+
+    // Reuse the original's buffer for different text, then free it
+    original->clear();
+    original->parseQuery("q=zz%20zz&name=w+w");
+    original.reset();
+
+    for (const RouteParams* params : {&copied, &assigned}) {
+        EXPECT_EQ(params->size(), 3u);
+        EXPECT_EQ(params->get("id"), "7");
+        EXPECT_EQ(params->get("q"), "a b");
+        EXPECT_EQ(params->get("name"), "x y");
+        EXPECT_FALSE(params->has("old"));
+    }
+
+    RouteParams& self = assigned;
+    assigned = self;
+    EXPECT_EQ(assigned.get("q"), "a b");
+}
+
+// A second query makes room in the decode buffer, which may move it
+TEST(RouteParamsTest, GrowingTheBufferKeepsEarlierValues) {
+    std::string longer = "b=" + std::string(512, '+');
+    RouteParams params;
+    params.parseQuery("a=%41");
+    params.parseQuery(longer);
+    EXPECT_EQ(params.get("a"), "A");
+    EXPECT_EQ(params.get("b"), std::string(512, ' '));
+}
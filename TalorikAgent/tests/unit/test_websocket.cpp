@@ -0,0 +1,298 @@
+#include <gtest/gtest.h>
+#include <asio.hpp>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "network/HttpServer.h"
+#include "network/WebSocket.h"
+
+namespace {
+
+constexpr uint64_t kNoLimit = UINT64_MAX;
+
+// A frame as a client must send it: masked, with the shortest length form
+std::string clientFrame(WebSocket::Opcode opcode, std::string_view payload, bool fin = true,
+                        uint32_t mask = 0x37fa213d) {
+    std::string frame;
+    frame.push_back(static_cast<char>((fin ? 0x80 : 0) | static_cast<uint8_t>(opcode)));
+    uint64_t length = payload.size();
+    if (length < 126) {
+        frame.push_back(static_cast<char>(0x80 | length));
+    } else if (length <= 0xffff) {
+        frame.push_back(static_cast<char>(0x80 | 126));
+        frame.push_back(static_cast<char>(length >> 8));
+        frame.push_back(static_cast<char>(length & 0xff));
+    } else {
+        frame.push_back(static_cast<char>(0x80 | 127));
+        for (int i = 7; i >= 0; --i) {
+            frame.push_back(static_cast<char>((length >> (i * 8)) & 0xff));
+        }
+    }
+    char key[4] = {static_cast<char>(mask >> 24), static_cast<char>(mask >> 16),
+                   static_cast<char>(mask >> 8), static_cast<char>(mask)};
+    frame.append(key, sizeof(key));
+    for (size_t i = 0; i < payload.size(); ++i) {
+        frame.push_back(static_cast<char>(payload[i] ^ key[i % 4]));
+    }
+    return frame;
+}
+
+// Just a frame header declaring length, for limits checked before the payload
+std::string clientHeader(WebSocket::Opcode opcode, uint64_t length) {
+    std::string frame;
+    frame.push_back(static_cast<char>(0x80 | static_cast<uint8_t>(opcode)));
+    frame.push_back(static_cast<char>(0x80 | 127));
+    for (int i = 7; i >= 0; --i) {
+        frame.push_back(static_cast<char>((length >> (i * 8)) & 0xff));
+    }
+    return frame;
+}
+
+std::string payloadOf(size_t size) {
+    std::string payload(size, '\0');
+    for (size_t i = 0; i < size; ++i) {
+        payload[i] = static_cast<char>('a' + i % 26);
+    }
+    return payload;
+}
+
+int freePort() {
+    asio::io_context ioContext;
+    asio::ip::tcp::acceptor acceptor(ioContext, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    return acceptor.local_endpoint().port();
+}
+
+}
+
+// The sample handshake from RFC 6455 section 1.3
+TEST(WebSocketTest, AcceptKeyMatchesTheRfcSample) {
+    EXPECT_EQ(WebSocket::acceptKey("dGhlIHNhbXBsZSBub25jZQ=="), "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+}
+
+// Server frames use the shortest of the 7-bit, 16-bit and 64-bit lengths
+TEST(WebSocketTest, EncodesLengthBoundaries) {
+    struct Boundary {
+        size_t length;
+        size_t headerSize;
+        uint8_t lengthByte;
+    };
+    for (Boundary boundary : {Boundary{0, 2, 0}, Boundary{125, 2, 125}, Boundary{126, 4, 126},
+                              Boundary{65535, 4, 126}, Boundary{65536, 10, 127}}) {
+        std::string payload = payloadOf(boundary.length);
+        std::string frame = WebSocket::encodeFrame(WebSocket::Opcode::Binary, payload);
+        SCOPED_TRACE("length " + std::to_string(boundary.length));
+
+        ASSERT_EQ(frame.size(), boundary.headerSize + boundary.length);
+        EXPECT_EQ(static_cast<uint8_t>(frame[0]), 0x82);
+        EXPECT_EQ(static_cast<uint8_t>(frame[1]), boundary.lengthByte);   // and no mask bit
+        uint64_t length = boundary.lengthByte;
+        if (boundary.headerSize > 2) {
+            length = 0;
+            for (size_t i = 2; i < boundary.headerSize; ++i) {
+                length = (length << 8) | static_cast<uint8_t>(frame[i]);
+            }
+        }
+        EXPECT_EQ(length, boundary.length);
+        EXPECT_EQ(frame.compare(boundary.headerSize, std::string::npos, payload), 0);
+    }
+}
+
+TEST(WebSocketTest, CloseFrameCarriesTheCode) {
+    EXPECT_EQ(WebSocket::closeFrame(WebSocket::kCloseProtocolError), std::string("\x88\x02\x03\xea", 4));
+}
+
+// Every length form decodes, and any prefix of a frame is Incomplete
+// without consuming input
+TEST(WebSocketTest, DecodesLengthBoundaries) {
+    for (size_t size : {size_t(0), size_t(125), size_t(126), size_t(65535), size_t(65536)}) {
+        SCOPED_TRACE("length " + std::to_string(size));
+        std::string payload = payloadOf(size);
+        std::string bytes = clientFrame(WebSocket::Opcode::Binary, payload) + "next";
+
+        WebSocket::Frame frame;
+        for (size_t prefix = 0; prefix < bytes.size() - 4; ++prefix) {
+            std::string_view input(bytes.data(), prefix);
+            ASSERT_EQ(WebSocket::decodeFrame(input, frame, kNoLimit), WebSocket::Result::Incomplete) << prefix;
+            ASSERT_EQ(input.size(), prefix);
+        }
+
+        std::string_view input(bytes);
+        ASSERT_EQ(WebSocket::decodeFrame(input, frame, kNoLimit), WebSocket::Result::Complete);
+        EXPECT_TRUE(frame.fin);
+        EXPECT_EQ(frame.opcode, WebSocket::Opcode::Binary);
+        EXPECT_EQ(frame.payload, payload);
+        EXPECT_EQ(input, "next");
+    }
+}
+
+TEST(WebSocketTest, DecodesFramesBackToBack) {
+    std::string bytes = clientFrame(WebSocket::Opcode::Text, "hel", false) +
+                        clientFrame(WebSocket::Opcode::Ping, "are you there?") +
+                        clientFrame(WebSocket::Opcode::Continuation, "lo");
+    std::string_view input(bytes);
+    WebSocket::Frame frame;
+
+    ASSERT_EQ(WebSocket::decodeFrame(input, frame, kNoLimit), WebSocket::Result::Complete);
+    EXPECT_FALSE(frame.fin);
+    EXPECT_EQ(frame.opcode, WebSocket::Opcode::Text);
+    EXPECT_EQ(frame.payload, "hel");
+
+    // Control frames may arrive between the pieces of a fragmented message
+    ASSERT_EQ(WebSocket::decodeFrame(input, frame, kNoLimit), WebSocket::Result::Complete);
+    EXPECT_EQ(frame.opcode, WebSocket::Opcode::Ping);
+    EXPECT_EQ(frame.payload, "are you there?");
+
+    ASSERT_EQ(WebSocket::decodeFrame(input, frame, kNoLimit), WebSocket::Result::Complete);
+    EXPECT_TRUE(frame.fin);
+    EXPECT_EQ(frame.opcode, WebSocket::Opcode::Continuation);
+    EXPECT_EQ(frame.payload, "lo");
+    EXPECT_TRUE(input.empty());
+}
+
+TEST(WebSocketTest, RejectsUnmaskedClientFrames) {
+    // A server frame is exactly a client frame without the mask
+    std::string unmasked = WebSocket::encodeFrame(WebSocket::Opcode::Text, "hello");
+    std::string_view input(unmasked);
+    WebSocket::Frame frame;
+    EXPECT_EQ(WebSocket::decodeFrame(input, frame, kNoLimit), WebSocket::Result::Error);
+
+    // Known from the first two bytes, before the rest arrives
+    std::string_view header(unmasked.data(), 2);
+    EXPECT_EQ(WebSocket::decodeFrame(header, frame, kNoLimit), WebSocket::Result::Error);
+}
+
+TEST(WebSocketTest, RejectsProtocolViolations) {
+    auto withFirstByte = [](std::string frame, uint8_t first) {
+        frame[0] = static_cast<char>(first);
+        return frame;
+    };
+    std::string text = clientFrame(WebSocket::Opcode::Text, "x");
+    const std::string violations[] = {
+        withFirstByte(text, 0xc1),      // RSV1, no extension negotiated
+        withFirstByte(text, 0xa1),      // RSV2
+        withFirstByte(text, 0x91),      // RSV3
+        withFirstByte(text, 0x83),      // reserved data opcode
+        withFirstByte(text, 0x87),
+        withFirstByte(text, 0x8b),      // reserved control opcode
+        withFirstByte(text, 0x8f),
+        clientFrame(WebSocket::Opcode::Ping, "x", false),                   // fragmented control frame
+        clientFrame(WebSocket::Opcode::Ping, payloadOf(126)),               // control payload over 125
+        clientFrame(WebSocket::Opcode::Close, payloadOf(126)),
+    };
+    for (const std::string& bytes : violations) {
+        std::string_view input(bytes);
+        WebSocket::Frame frame;
+        EXPECT_EQ(WebSocket::decodeFrame(input, frame, kNoLimit), WebSocket::Result::Error)
+            << std::hex << static_cast<int>(static_cast<uint8_t>(bytes[0])) << " " << bytes.size();
+    }
+}
+
+// Oversized frames are refused from their header, before the payload is buffered
+TEST(WebSocketTest, EnforcesMaxPayload) {
+    std::string atLimit = clientFrame(WebSocket::Opcode::Binary, payloadOf(1000));
+    std::string_view input(atLimit);
+    WebSocket::Frame frame;
+    EXPECT_EQ(WebSocket::decodeFrame(input, frame, 1000), WebSocket::Result::Complete);
+
+    std::string overLimit = clientFrame(WebSocket::Opcode::Binary, payloadOf(1001));
+    input = std::string_view(overLimit.data(), 4);
+    EXPECT_EQ(WebSocket::decodeFrame(input, frame, 1000), WebSocket::Result::Error);
+
+    std::string huge = clientHeader(WebSocket::Opcode::Binary, UINT64_MAX);
+    input = huge;
+    EXPECT_EQ(WebSocket::decodeFrame(input, frame, 1000), WebSocket::Result::Error);
+}
+
+namespace {
+
+// Upgraded connection to a server with one WebSocket route
+class HttpServerWebSocketTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        HttpServer::Options options;
+        options.port = freePort();
+        options.workerThreads = 1;
+        m_server = std::make_unique<HttpServer>(options);
+        m_server->addWebSocketRoute("/ws");
+        m_server->start();
+
+        m_socket.connect(asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(),
+                                                 static_cast<unsigned short>(options.port)));
+        asio::write(m_socket, asio::buffer(std::string(
+            "GET /ws HTTP/1.1\r\nHost: test\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n")));
+        size_t headEnd = asio::read_until(m_socket, asio::dynamic_buffer(m_buffer), "\r\n\r\n");
+        std::string head = m_buffer.substr(0, headEnd);
+        m_buffer.erase(0, headEnd);
+        ASSERT_EQ(head.compare(0, 12, "HTTP/1.1 101"), 0) << head;
+        ASSERT_NE(head.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n"), std::string::npos) << head;
+    }
+
+    void TearDown() override {
+        m_server->stop();
+    }
+
+    // Reads until the buffer holds size bytes; false if the connection
+    // ended first or nothing came within a few seconds
+    bool readAtLeast(size_t size) {
+        if (m_buffer.size() >= size) {
+            return true;
+        }
+        bool done = false;
+        asio::async_read(m_socket, asio::dynamic_buffer(m_buffer), asio::transfer_at_least(size - m_buffer.size()),
+            [&done](std::error_code, size_t) { done = true; });
+        m_ioContext.restart();
+        m_ioContext.run_for(std::chrono::seconds(5));
+        if (!done) {
+            m_socket.cancel();
+            m_ioContext.run();
+        }
+        return m_buffer.size() >= size;
+    }
+
+    // Next frame from the server, which sends unmasked frames of 125 bytes
+    // or less here; empty if none arrives
+    std::string readFrame() {
+        if (!readAtLeast(2) || !readAtLeast(2 + static_cast<uint8_t>(m_buffer[1]))) {
+            return std::string();
+        }
+        size_t size = 2 + static_cast<uint8_t>(m_buffer[1]);
+        std::string frame = m_buffer.substr(0, size);
+        m_buffer.erase(0, size);
+        return frame;
+    }
+
+    asio::io_context m_ioContext;
+    asio::ip::tcp::socket m_socket{m_ioContext};
+    std::string m_buffer;
+    std::unique_ptr<HttpServer> m_server;
+};
+
+}
+
+// Frames up to the server's 64 KiB limit are read (and, being data, ignored)
+TEST_F(HttpServerWebSocketTest, AcceptsPayloadsUpToTheLimit) {
+    asio::write(m_socket, asio::buffer(clientFrame(WebSocket::Opcode::Binary, payloadOf(64 * 1024)) +
+                                       clientFrame(WebSocket::Opcode::Ping, "still there?")));
+    EXPECT_EQ(readFrame(), WebSocket::encodeFrame(WebSocket::Opcode::Pong, "still there?"));
+}
+
+TEST_F(HttpServerWebSocketTest, ClosesOnPayloadsOverTheLimit) {
+    asio::write(m_socket, asio::buffer(clientHeader(WebSocket::Opcode::Binary, 64 * 1024 + 1)));
+    EXPECT_EQ(readFrame(), WebSocket::closeFrame(WebSocket::kCloseProtocolError));
+}
+
+TEST_F(HttpServerWebSocketTest, ClosesOnUnmaskedFrames) {
+    asio::write(m_socket, asio::buffer(WebSocket::encodeFrame(WebSocket::Opcode::Ping, "x")));
+    EXPECT_EQ(readFrame(), WebSocket::closeFrame(WebSocket::kCloseProtocolError));
+}
+
+TEST_F(HttpServerWebSocketTest, EchoesClose) {
+    asio::write(m_socket, asio::buffer(clientFrame(WebSocket::Opcode::Close, std::string("\x03\xe8", 2))));
+    EXPECT_EQ(readFrame(), WebSocket::closeFrame(WebSocket::kCloseNormal));
+
+    // And then ends the connection
+    EXPECT_FALSE(readAtLeast(1));
+}